@@ -0,0 +1,91 @@
+//
+// Created by dwd on 10/17/26.
+//
+
+#include <covent/loop.h>
+#include <covent/datagram.h>
+#include <benchmark/benchmark.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Datagrams per second through one loop's core. Receiving, a separate thread floods the endpoint
+// over loopback, either one datagram per message or as GSO sends (which a GRO endpoint gets whole);
+// the endpoint reads with recvmmsg one at a time or 32 at once. Sending, the endpoint fires 64-datagram
+// batches at a socket nobody reads, with or without GSO.
+
+namespace {
+    constexpr std::size_t payload_size = 64;
+
+    covent::task<std::size_t> drain(covent::DatagramEndpoint & endpoint, std::size_t count) {
+        std::size_t received = 0;
+        while (received < count) {
+            auto batch = co_await endpoint.recv_batch();
+            received += batch.size();
+        }
+        co_return received;
+    }
+
+    void BM_Datagram_Recv(benchmark::State & state) {
+        auto const batch = static_cast<std::size_t>(state.range(0));
+        auto const sender_gso = state.range(1) != 0;
+        covent::Loop loop;
+        covent::DatagramEndpoint endpoint(loop, "::1", 0, {.batch = batch, .max_size = payload_size, .options = {.receive_buffer = 4 << 20}});
+        std::atomic<bool> stop = false;
+        std::jthread sender([&endpoint, &stop, sender_gso]() {
+            auto fd = ::socket(AF_INET6, SOCK_DGRAM, 0);
+            ::connect(fd, endpoint.sockaddr(), sizeof(struct sockaddr_in6));
+            std::vector<char> payload(payload_size * 32, 'x');
+            std::vector<struct mmsghdr> messages(32);
+            std::vector<struct iovec> iov(32);
+            for (std::size_t i = 0; i != iov.size(); ++i) {
+                iov[i] = {payload.data() + i * payload_size, payload_size};
+                messages[i].msg_hdr = {.msg_iov = &iov[i], .msg_iovlen = 1};
+            }
+#ifdef UDP_SEGMENT
+            if (sender_gso) {
+                int segment = payload_size;
+                ::setsockopt(fd, SOL_UDP, UDP_SEGMENT, &segment, sizeof(segment));
+                messages.resize(1);
+                iov.resize(1);
+                iov[0] = {payload.data(), payload.size()};
+            }
+#endif
+            while (!stop) {
+                if (::sendmmsg(fd, messages.data(), static_cast<unsigned int>(messages.size()), 0) < 0) std::this_thread::yield();
+            }
+            ::close(fd);
+        });
+        std::size_t received = 0;
+        for (auto _ : state) {
+            received += loop.run_task(drain(endpoint, 1024));
+        }
+        stop = true;
+        sender.join();
+        state.SetItemsProcessed(static_cast<std::int64_t>(received));
+        state.counters["coalesced"] = static_cast<double>(endpoint.stats().coalesced);
+    }
+    BENCHMARK(BM_Datagram_Recv)->ArgNames({"batch", "gso"})->Args({1, 0})->Args({32, 0})->Args({32, 1})->UseRealTime();
+
+    void BM_Datagram_Send(benchmark::State & state) {
+        covent::Loop loop;
+        covent::DatagramEndpoint sink(loop, "::1", 0);
+        covent::DatagramEndpoint endpoint(loop, "::1", 0, {.gso = state.range(0) != 0});
+        std::string payload(1200, 'x');
+        std::vector<covent::Datagram> out(64, {payload, sink.sockaddr()});
+        std::size_t sent = 0;
+        for (auto _ : state) {
+            sent += endpoint.try_send(out);
+            sink.try_recv(); // Keep its buffer from filling.
+        }
+        state.SetItemsProcessed(static_cast<std::int64_t>(sent));
+        state.counters["calls"] = static_cast<double>(endpoint.stats().send_calls);
+    }
+    BENCHMARK(BM_Datagram_Send)->ArgNames({"gso"})->Arg(0)->Arg(1);
+}
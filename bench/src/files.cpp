@@ -0,0 +1,99 @@
+//
+// Created by dwd on 10/17/26.
+//
+
+#include <covent/loop.h>
+#include <covent/listener.h>
+#include <benchmark/benchmark.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+// Serving a 1GiB file: read into userspace and written out through the session, or handed to
+// write_file() so the kernel sends it. The file is sparse, so this measures the copying rather
+// than the disk.
+
+namespace {
+    constexpr ev_off_t file_size = ev_off_t{1} << 30;
+    constexpr std::size_t chunk_size = 1 << 20;
+
+    class Sink : public covent::Session {
+    public:
+        using covent::Session::Session;
+
+        covent::task<std::size_t> process(std::string_view data) override {
+            co_return data.size();
+        }
+    };
+
+    void serve(benchmark::State & state, bool sendfile) {
+        char path[] = "/tmp/covent-bench-file-XXXXXX";
+        int file = mkstemp(path);
+        if (file < 0 || ::ftruncate(file, file_size) != 0) {
+            state.SkipWithError("Couldn't create file");
+            return;
+        }
+        ::unlink(path);
+        covent::Loop loop;
+        covent::Listener<Sink> listener(loop, "::1", 0); // Never listens; just a session factory.
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+            state.SkipWithError("socketpair failed");
+            return;
+        }
+        evutil_make_socket_nonblocking(fds[0]);
+        auto session = std::make_shared<Sink>(loop, fds[0], listener);
+        loop.add(session);
+        std::atomic<std::size_t> received = 0;
+        std::jthread reader([fd = fds[1], &received]() {
+            std::vector<char> scratch(1 << 20);
+            for (;;) {
+                auto n = ::recv(fd, scratch.data(), scratch.size(), 0);
+                if (n <= 0) return;
+                received += static_cast<std::size_t>(n);
+            }
+        });
+        std::vector<char> chunk(chunk_size);
+        std::size_t sent = 0;
+        // The last of the output may drain with nothing left to wake the loop, so poll it.
+        auto wait_for = [&loop, &received](std::size_t target) {
+            while (received < target) {
+                loop.run_once(false);
+                std::this_thread::yield();
+            }
+        };
+        for (auto _ : state) {
+            if (sendfile) {
+                session->write_file(file);
+                sent += file_size;
+            } else {
+                for (ev_off_t off = 0; off < file_size; off += chunk_size) {
+                    auto n = ::pread(file, chunk.data(), chunk.size(), off);
+                    session->write({chunk.data(), static_cast<std::size_t>(n)});
+                    sent += static_cast<std::size_t>(n);
+                    // Don't buffer the whole file; a server wouldn't.
+                    if (sent > 16 * chunk_size) wait_for(sent - 16 * chunk_size);
+                }
+            }
+            wait_for(sent);
+        }
+        ::shutdown(fds[1], SHUT_RDWR);
+        reader.join();
+        ::close(fds[1]);
+        ::close(file);
+        state.SetBytesProcessed(static_cast<std::int64_t>(sent));
+    }
+
+    void BM_File_Copy(benchmark::State & state) {
+        serve(state, false);
+    }
+    BENCHMARK(BM_File_Copy)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+    void BM_File_Sendfile(benchmark::State & state) {
+        serve(state, true);
+    }
+    BENCHMARK(BM_File_Sendfile)->Unit(benchmark::kMillisecond)->UseRealTime();
+}
@@ -0,0 +1,167 @@
+//
+// Created by dwd on 10/17/26.
+//
+
+#include <covent/loop.h>
+#include <covent/offload.h>
+#include <covent/sleep.h>
+#include <benchmark/benchmark.h>
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+#include <algorithm>
+
+// Loop latency while the loop is also parsing CRLs and verifying chains - inline, as CrlCache
+// and PKIXValidator used to, and via offload(). A ticker coroutine sleeps for 1ms at a time and
+// records how late it wakes; with the work offloaded, that should stay flat.
+
+namespace {
+    using clock = std::chrono::steady_clock;
+    using namespace std::chrono_literals;
+
+    struct Pki {
+        EVP_PKEY * key = nullptr;
+        X509 * ca = nullptr;
+        X509 * leaf = nullptr;
+        X509_STORE * store = nullptr;
+        std::string crl_der;
+
+        static X509 * make_cert(char const * cn, EVP_PKEY * key, X509 * issuer, EVP_PKEY * issuer_key, long serial) {
+            auto * cert = X509_new();
+            X509_set_version(cert, 2);
+            ASN1_INTEGER_set(X509_get_serialNumber(cert), serial);
+            X509_gmtime_adj(X509_getm_notBefore(cert), -3600);
+            X509_gmtime_adj(X509_getm_notAfter(cert), 86400);
+            X509_set_pubkey(cert, key);
+            auto * name = X509_get_subject_name(cert);
+            X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char *>(cn), -1, -1, 0);
+            X509_set_issuer_name(cert, issuer ? X509_get_subject_name(issuer) : name);
+            if (!issuer) {
+                X509V3_CTX ctx;
+                X509V3_set_ctx_nodb(&ctx);
+                X509V3_set_ctx(&ctx, cert, cert, nullptr, nullptr, 0);
+                auto * ext = X509V3_EXT_conf_nid(nullptr, &ctx, NID_basic_constraints, "critical,CA:TRUE");
+                X509_add_ext(cert, ext, -1);
+                X509_EXTENSION_free(ext);
+            }
+            X509_sign(cert, issuer_key, EVP_sha256());
+            return cert;
+        }
+
+        explicit Pki(long revoked) {
+            key = EVP_RSA_gen(2048);
+            ca = make_cert("Bench CA", key, nullptr, key, 1);
+            leaf = make_cert("bench.example", key, ca, key, 2);
+            store = X509_STORE_new();
+            X509_STORE_add_cert(store, ca);
+            auto * crl = X509_CRL_new();
+            X509_CRL_set_version(crl, 1);
+            X509_CRL_set_issuer_name(crl, X509_get_subject_name(ca));
+            auto * now = ASN1_TIME_adj(nullptr, time(nullptr), 0, 0);
+            auto * next = ASN1_TIME_adj(nullptr, time(nullptr), 1, 0);
+            X509_CRL_set1_lastUpdate(crl, now);
+            X509_CRL_set1_nextUpdate(crl, next);
+            for (long serial = 1000; serial != 1000 + revoked; ++serial) {
+                auto * rev = X509_REVOKED_new();
+                auto * s = ASN1_INTEGER_new();
+                ASN1_INTEGER_set(s, serial);
+                X509_REVOKED_set_serialNumber(rev, s);
+                X509_REVOKED_set_revocationDate(rev, now);
+                X509_CRL_add0_revoked(crl, rev);
+                ASN1_INTEGER_free(s);
+            }
+            X509_CRL_sort(crl);
+            X509_CRL_sign(crl, key, EVP_sha256());
+            unsigned char * der = nullptr;
+            auto len = i2d_X509_CRL(crl, &der);
+            crl_der.assign(reinterpret_cast<char *>(der), static_cast<std::size_t>(len));
+            OPENSSL_free(der);
+            X509_CRL_free(crl);
+            ASN1_TIME_free(now);
+            ASN1_TIME_free(next);
+        }
+        ~Pki() {
+            X509_STORE_free(store);
+            X509_free(leaf);
+            X509_free(ca);
+            EVP_PKEY_free(key);
+        }
+
+        // The same work CrlCache::do_crl and PKIXValidator::verify_tls do.
+        bool parse_crl() const {
+            auto const * p = reinterpret_cast<const unsigned char *>(crl_der.data());
+            auto * crl = d2i_X509_CRL(nullptr, &p, static_cast<long>(crl_der.size()));
+            X509_CRL_free(crl);
+            return crl != nullptr;
+        }
+        bool verify() const {
+            auto * st = X509_STORE_CTX_new();
+            X509_STORE_CTX_init(st, store, leaf, nullptr);
+            bool ok = X509_verify_cert(st) == 1;
+            X509_STORE_CTX_free(st);
+            return ok;
+        }
+    };
+
+    struct Lag {
+        std::vector<clock::duration> samples;
+        bool stop = false;
+    };
+
+    covent::task<void> ticker(covent::Loop &, Lag & lag) {
+        while (!lag.stop) {
+            auto start = clock::now();
+            co_await covent::sleep(0.001);
+            lag.samples.push_back(clock::now() - start - 1ms);
+        }
+    }
+
+    covent::task<void> workload(covent::Loop &, Pki const & pki, bool offloaded, int jobs) {
+        for (int i = 0; i != jobs; ++i) {
+            if (offloaded) {
+                benchmark::DoNotOptimize(co_await covent::offload([&pki]() { return pki.parse_crl(); }));
+                benchmark::DoNotOptimize(co_await covent::offload([&pki]() { return pki.verify(); }));
+            } else {
+                benchmark::DoNotOptimize(pki.parse_crl());
+                benchmark::DoNotOptimize(pki.verify());
+            }
+            // Give the loop a look-in between jobs either way, as a real server would.
+            co_await covent::sleep(0);
+        }
+    }
+
+    void loop_lag(benchmark::State & state, bool offloaded) {
+        Pki pki(state.range(0));
+        covent::Loop loop;
+        std::vector<clock::duration> all;
+        for (auto _ : state) {
+            Lag lag;
+            auto tick = ticker(loop, lag);
+            tick.start();
+            loop.run_task(workload(loop, pki, offloaded, 16));
+            lag.stop = true;
+            loop.run_until([&tick]() { return tick.done(); });
+            all.insert(all.end(), lag.samples.begin(), lag.samples.end());
+        }
+        std::ranges::sort(all);
+        auto us = [](clock::duration d) {
+            return static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(d).count());
+        };
+        if (!all.empty()) {
+            state.counters["lag_p50_us"] = us(all[all.size() / 2]);
+            state.counters["lag_p99_us"] = us(all[all.size() * 99 / 100]);
+            state.counters["lag_max_us"] = us(all.back());
+        }
+        state.SetItemsProcessed(state.iterations() * 16);
+    }
+
+    void BM_LoopLag_Inline(benchmark::State & state) {
+        loop_lag(state, false);
+    }
+    BENCHMARK(BM_LoopLag_Inline)->Arg(10'000)->Arg(100'000)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+    void BM_LoopLag_Offload(benchmark::State & state) {
+        loop_lag(state, true);
+    }
+    BENCHMARK(BM_LoopLag_Offload)->Arg(10'000)->Arg(100'000)->Unit(benchmark::kMillisecond)->UseRealTime();
+}
@@ -0,0 +1,90 @@
+//
+// Created by dwd on 10/17/26.
+//
+
+#include <covent/loop.h>
+#include <benchmark/benchmark.h>
+#include <future>
+#include <thread>
+
+// Round trips between two Loops on different threads. Each iteration hands a call to the
+// other Loop, which hands one straight back; the benchmark thread blocks in its own Loop until
+// the reply arrives, so this measures cross-thread wakeup latency in both directions. The Defer
+// variant goes through the timer wheel and its mutex, as cross-thread resumption used to.
+
+namespace {
+    struct Remote {
+        std::promise<covent::Loop *> started;
+        covent::Loop * loop = nullptr;
+        std::thread thread;
+
+        Remote() {
+            auto future = started.get_future();
+            thread = std::thread([this]() {
+                covent::Loop l;
+                started.set_value(&l);
+                l.run();
+            });
+            loop = future.get();
+        }
+        ~Remote() {
+            loop->shutdown();
+            thread.join();
+        }
+    };
+
+    void BM_PingPong_Post(benchmark::State & state) {
+        covent::Loop local;
+        Remote remote;
+        bool returned = false;
+        for (auto _ : state) {
+            returned = false;
+            remote.loop->post([&local, &returned]() {
+                local.post([&returned]() {
+                    returned = true;
+                });
+            });
+            while (!returned) local.run_once(true);
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+    BENCHMARK(BM_PingPong_Post)->UseRealTime();
+
+    void BM_PingPong_Defer(benchmark::State & state) {
+        covent::Loop local;
+        Remote remote;
+        bool returned = false;
+        for (auto _ : state) {
+            returned = false;
+            remote.loop->defer([&local, &returned]() {
+                local.defer([&returned]() {
+                    returned = true;
+                });
+            });
+            while (!returned) local.run_once(true);
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+    BENCHMARK(BM_PingPong_Defer)->UseRealTime();
+
+    // Many calls in flight at once: the consumer should take one wakeup per batch, not per call.
+    void BM_PingPong_Burst(benchmark::State & state) {
+        covent::Loop local;
+        Remote remote;
+        auto const burst = state.range(0);
+        std::int64_t returned = 0;
+        for (auto _ : state) {
+            returned = 0;
+            for (std::int64_t i = 0; i != burst; ++i) {
+                remote.loop->post([&local, &returned]() {
+                    local.post([&returned]() {
+                        ++returned;
+                    });
+                });
+            }
+            while (returned != burst) local.run_once(true);
+        }
+        state.SetItemsProcessed(state.iterations() * burst);
+    }
+    BENCHMARK(BM_PingPong_Burst)->Arg(64)->Arg(1024)->UseRealTime();
+}
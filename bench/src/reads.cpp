@@ -0,0 +1,94 @@
+//
+// Created by dwd on 10/17/26.
+//
+
+#include <covent/loop.h>
+#include <covent/listener.h>
+#include <benchmark/benchmark.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <string>
+#include <thread>
+
+// Receiving large messages that arrive over many reads. A processor which needs the whole message
+// returns 0 until it's all there; with process(string_view) that means pulling the entire input
+// up on every read, while process_segments() just looks at the segments where they lie.
+
+namespace {
+    std::size_t s_message_size = 0;
+    std::size_t s_received = 0;
+
+    class PullupSink : public covent::Session {
+    public:
+        PullupSink(covent::Loop & l, evutil_socket_t sock, covent::ListenerBase & b) : covent::Session(l, sock, b) {}
+
+        covent::task<std::size_t> process(std::string_view data) override {
+            if (data.size() < s_message_size) co_return 0;
+            benchmark::DoNotOptimize(data.data());
+            ++s_received;
+            co_return s_message_size;
+        }
+    };
+
+    class ScatterSink : public covent::Session {
+    public:
+        ScatterSink(covent::Loop & l, evutil_socket_t sock, covent::ListenerBase & b) : covent::Session(l, sock, b) {
+            scatter_read();
+        }
+
+        covent::task<std::size_t> process_segments(segments_type data) override {
+            std::size_t len = 0;
+            for (auto const & segment : data) len += segment.size();
+            if (len < s_message_size) co_return 0;
+            ++s_received;
+            co_return s_message_size;
+        }
+    };
+
+    template<typename S>
+    void receive(benchmark::State & state) {
+        s_message_size = static_cast<std::size_t>(state.range(0));
+        s_received = 0;
+        covent::Loop loop;
+        covent::Listener<S> listener(loop, "::1", 0); // Never listens; just a session factory.
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+            state.SkipWithError("socketpair failed");
+            return;
+        }
+        evutil_make_socket_nonblocking(fds[0]);
+        listener.create_session(fds[0]);
+        std::atomic<bool> stop = false;
+        std::jthread writer([fd = fds[1], &stop]() {
+            std::string message(s_message_size, 'x');
+            while (!stop) {
+                for (std::size_t off = 0; off < message.size();) {
+                    auto n = ::send(fd, message.data() + off, message.size() - off, MSG_NOSIGNAL);
+                    if (n <= 0) return;
+                    off += static_cast<std::size_t>(n);
+                }
+            }
+        });
+        std::size_t expected = 0;
+        for (auto _ : state) {
+            ++expected;
+            loop.run_until([expected]() { return s_received >= expected; });
+        }
+        stop = true;
+        ::shutdown(fds[1], SHUT_RDWR);
+        writer.join();
+        ::close(fds[1]);
+        state.SetBytesProcessed(state.iterations() * state.range(0));
+    }
+
+    void BM_Read_Pullup(benchmark::State & state) {
+        receive<PullupSink>(state);
+    }
+    BENCHMARK(BM_Read_Pullup)->Arg(64 << 10)->Arg(1 << 20)->Arg(4 << 20)->UseRealTime();
+
+    void BM_Read_Scatter(benchmark::State & state) {
+        receive<ScatterSink>(state);
+    }
+    BENCHMARK(BM_Read_Scatter)->Arg(64 << 10)->Arg(1 << 20)->Arg(4 << 20)->UseRealTime();
+}
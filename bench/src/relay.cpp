@@ -0,0 +1,112 @@
+//
+// Created by dwd on 10/17/26.
+//
+
+#include <covent/loop.h>
+#include <covent/listener.h>
+#include <covent/relay.h>
+#include <benchmark/benchmark.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Proxy throughput: a thread writes flat out into one session's socket, another reads from the far end
+// of the other's. In between, relay() splices or moves buffers across; the baseline is the obvious
+// process() that write()s everything it's given to the other session, copying it on the way.
+
+namespace {
+    class Forward : public covent::Session {
+    public:
+        using covent::Session::Session;
+        covent::Session * peer = nullptr;
+
+        covent::task<std::size_t> process(std::string_view data) override {
+            if (peer) peer->write(data);
+            co_return data.size();
+        }
+    };
+
+    void proxy(benchmark::State & state, int mode) {
+        covent::Loop loop;
+        covent::Listener<Forward> listener(loop, "::1", 0); // Never listens; just a session factory.
+        int in[2];
+        int out[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, in) != 0 || socketpair(AF_UNIX, SOCK_STREAM, 0, out) != 0) {
+            state.SkipWithError("socketpair failed");
+            return;
+        }
+        evutil_make_socket_nonblocking(in[0]);
+        evutil_make_socket_nonblocking(out[0]);
+        auto a = std::make_shared<Forward>(loop, in[0], listener);
+        auto b = std::make_shared<Forward>(loop, out[0], listener);
+        loop.add(a);
+        loop.add(b);
+        std::optional<covent::task<covent::RelayStats>> relay;
+        if (mode == 0) {
+            a->peer = b.get();
+        } else {
+            relay.emplace(covent::relay(*a, *b, {.splice = mode == 2}));
+            relay->start();
+        }
+        for (auto fd : {in[1], out[1]}) {
+            struct timeval tv{0, 100000}; // Blocking, but checking for the end now and then.
+            setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        }
+        std::atomic<std::size_t> received = 0;
+        std::atomic<bool> writing = true;
+        std::atomic<bool> stop = false;
+        std::jthread writer([fd = in[1], &writing]() {
+            std::vector<char> payload(1 << 16, 'x');
+            while (writing) ::send(fd, payload.data(), payload.size(), MSG_NOSIGNAL);
+        });
+        std::jthread reader([fd = out[1], &received, &stop]() {
+            std::vector<char> scratch(1 << 16);
+            while (true) {
+                auto n = ::recv(fd, scratch.data(), scratch.size(), 0);
+                if (n > 0) {
+                    received += static_cast<std::size_t>(n);
+                } else if (n == 0 || stop) {
+                    break;
+                }
+            }
+        });
+        std::size_t target = 0;
+        for (auto _ : state) {
+            target += 1 << 20;
+            while (received < target) loop.run_once(true);
+        }
+        state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations()) << 20);
+        // Wind down in order, so the relay can finish cleanly: nothing's written into a socket nobody reads.
+        writing = false;
+        writer.join();
+        ::shutdown(in[1], SHUT_WR);
+        ::shutdown(out[1], SHUT_WR);
+        if (relay) loop.run_until([&relay]() { return relay->done(); });
+        stop = true;
+        reader.join();
+        ::close(in[1]);
+        ::close(out[1]);
+    }
+
+    void BM_Relay_Copy(benchmark::State & state) {
+        proxy(state, 0);
+    }
+    BENCHMARK(BM_Relay_Copy)->UseRealTime();
+
+    void BM_Relay_Buffers(benchmark::State & state) {
+        proxy(state, 1);
+    }
+    BENCHMARK(BM_Relay_Buffers)->UseRealTime();
+
+    void BM_Relay_Splice(benchmark::State & state) {
+        proxy(state, 2);
+    }
+    BENCHMARK(BM_Relay_Splice)->UseRealTime();
+}
@@ -0,0 +1,101 @@
+//
+// Created by dwd on 10/17/26.
+//
+
+#include <covent/slot-map.h>
+#include <benchmark/benchmark.h>
+#include <memory>
+#include <random>
+#include <set>
+
+// Session registry costs at 500k sessions: the per-read-callback lookup, and the add/remove
+// churn of connections coming and going. The std::set variant is what the Loop used to use.
+
+namespace {
+    constexpr std::size_t session_count = 500'000;
+
+    struct FakeSession {
+        std::uint64_t id;
+    };
+    struct Compare {
+        using is_transparent = void;
+        bool operator()(std::uint64_t id, std::shared_ptr<FakeSession> const & o) const { return id < o->id; }
+        bool operator()(std::shared_ptr<FakeSession> const & o, std::uint64_t id) const { return o->id < id; }
+        bool operator()(std::shared_ptr<FakeSession> const & a, std::shared_ptr<FakeSession> const & b) const { return a->id < b->id; }
+    };
+    using Map = covent::detail::SlotMap<std::shared_ptr<FakeSession>>;
+
+    std::vector<std::size_t> order(std::size_t count) {
+        std::vector<std::size_t> result(count);
+        for (std::size_t i = 0; i != count; ++i) result[i] = i;
+        std::ranges::shuffle(result, std::mt19937_64(42));
+        return result;
+    }
+
+    void BM_SlotMap_Lookup(benchmark::State & state) {
+        Map map;
+        std::vector<Map::id_type> ids;
+        for (std::size_t i = 0; i != session_count; ++i) {
+            auto id = map.reserve();
+            map.attach(id, std::make_shared<FakeSession>(id));
+            ids.push_back(id);
+        }
+        auto const o = order(session_count);
+        std::size_t i = 0;
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(map.find(ids[o[i++ % o.size()]]));
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+    BENCHMARK(BM_SlotMap_Lookup);
+
+    void BM_Set_Lookup(benchmark::State & state) {
+        std::set<std::shared_ptr<FakeSession>, Compare> set;
+        for (std::uint64_t i = 0; i != session_count; ++i) set.emplace(std::make_shared<FakeSession>(i));
+        auto const o = order(session_count);
+        std::size_t i = 0;
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(set.find(static_cast<std::uint64_t>(o[i++ % o.size()])));
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+    BENCHMARK(BM_Set_Lookup);
+
+    void BM_SlotMap_Churn(benchmark::State & state) {
+        Map map;
+        std::vector<Map::id_type> ids;
+        for (std::size_t i = 0; i != session_count; ++i) {
+            auto id = map.reserve();
+            map.attach(id, std::make_shared<FakeSession>(id));
+            ids.push_back(id);
+        }
+        auto const o = order(session_count);
+        auto spare = std::make_shared<FakeSession>(0);
+        std::size_t i = 0;
+        for (auto _ : state) {
+            auto & id = ids[o[i++ % o.size()]];
+            map.release(id);
+            id = map.reserve();
+            map.attach(id, spare);
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+    BENCHMARK(BM_SlotMap_Churn);
+
+    void BM_Set_Churn(benchmark::State & state) {
+        std::set<std::shared_ptr<FakeSession>, Compare> set;
+        for (std::uint64_t i = 0; i != session_count; ++i) set.emplace(std::make_shared<FakeSession>(i));
+        auto const o = order(session_count);
+        std::uint64_t next = session_count;
+        std::vector<std::uint64_t> ids(o.begin(), o.end());
+        std::size_t i = 0;
+        for (auto _ : state) {
+            auto & id = ids[i++ % ids.size()];
+            auto node = set.extract(set.find(id));
+            node.value()->id = id = next++;
+            set.insert(std::move(node));
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+    BENCHMARK(BM_Set_Churn);
+}
@@ -0,0 +1,128 @@
+//
+// Created by dwd on 10/17/26.
+//
+
+#include <covent/timer-wheel.h>
+#include <benchmark/benchmark.h>
+#include <map>
+#include <random>
+
+// Insert, cancel and fire costs with a million timers already pending, which is roughly where
+// a busy server sits with idle timeouts and retries. The multimap variants are what the Loop
+// used to do, kept here for comparison.
+
+namespace {
+    using Wheel = covent::detail::TimerWheel;
+    using namespace std::chrono_literals;
+    constexpr std::size_t pending_timers = 1'000'000;
+
+    std::vector<Wheel::clock::duration> delays(std::size_t count) {
+        std::mt19937_64 rng(42);
+        std::uniform_int_distribution<std::int64_t> dist(1, 600'000'000); // Up to ten minutes, in microseconds.
+        std::vector<Wheel::clock::duration> result;
+        result.reserve(count);
+        for (std::size_t i = 0; i != count; ++i) {
+            result.emplace_back(std::chrono::microseconds(dist(rng)));
+        }
+        return result;
+    }
+
+    void BM_TimerWheel_Insert(benchmark::State & state) {
+        auto origin = Wheel::clock::now();
+        Wheel wheel(origin);
+        auto const d = delays(pending_timers);
+        for (auto delay : d) wheel.add([]() {}, delay, origin);
+        std::size_t i = 0;
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(wheel.add([]() {}, d[i++ % d.size()], origin));
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+    BENCHMARK(BM_TimerWheel_Insert);
+
+    void BM_TimerWheel_Cancel(benchmark::State & state) {
+        auto origin = Wheel::clock::now();
+        Wheel wheel(origin);
+        auto const d = delays(pending_timers);
+        std::vector<Wheel::id_type> ids;
+        ids.reserve(d.size());
+        for (auto delay : d) ids.push_back(wheel.add([]() {}, delay, origin));
+        std::size_t i = 0;
+        for (auto _ : state) {
+            if (i == ids.size()) {
+                state.PauseTiming();
+                for (std::size_t j = 0; j != d.size(); ++j) ids[j] = wheel.add([]() {}, d[j], origin);
+                i = 0;
+                state.ResumeTiming();
+            }
+            benchmark::DoNotOptimize(wheel.cancel(ids[i++]));
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+    BENCHMARK(BM_TimerWheel_Cancel);
+
+    void BM_TimerWheel_Fire(benchmark::State & state) {
+        // Each millisecond fires (on average) about two timers; each iteration is one turn of the wheel.
+        auto origin = Wheel::clock::now();
+        Wheel wheel(origin);
+        auto const d = delays(pending_timers);
+        for (auto delay : d) wheel.add([]() {}, delay, origin);
+        std::vector<std::function<void()>> out;
+        auto now = origin;
+        std::size_t fired = 0;
+        for (auto _ : state) {
+            now += 1ms;
+            out.clear();
+            wheel.expire(out, now);
+            for (auto const & fn : out) fn();
+            fired += out.size();
+            // Top up, so we stay at around a million pending.
+            for (std::size_t j = 0; j != out.size(); ++j) wheel.add([]() {}, d[(fired + j) % d.size()], now);
+        }
+        state.SetItemsProcessed(static_cast<std::int64_t>(fired));
+        state.counters["pending"] = static_cast<double>(wheel.size());
+    }
+    BENCHMARK(BM_TimerWheel_Fire);
+
+    struct Less {
+        bool operator()(Wheel::clock::time_point a, Wheel::clock::time_point b) const {
+            return a < b;
+        }
+    };
+
+    void BM_Multimap_Insert(benchmark::State & state) {
+        auto origin = Wheel::clock::now();
+        std::multimap<Wheel::clock::time_point, std::function<void()>, Less> timers;
+        auto const d = delays(pending_timers);
+        for (auto delay : d) timers.emplace(origin + delay, []() {});
+        std::size_t i = 0;
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(timers.emplace(origin + d[i++ % d.size()], []() {}));
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+    BENCHMARK(BM_Multimap_Insert);
+
+    void BM_Multimap_Fire(benchmark::State & state) {
+        auto origin = Wheel::clock::now();
+        std::multimap<Wheel::clock::time_point, std::function<void()>, Less> timers;
+        auto const d = delays(pending_timers);
+        for (auto delay : d) timers.emplace(origin + delay, []() {});
+        std::vector<std::function<void()>> out;
+        auto now = origin;
+        std::size_t fired = 0;
+        for (auto _ : state) {
+            now += 1ms;
+            out.clear();
+            while (!timers.empty() && timers.begin()->first <= now) {
+                out.emplace_back(std::move(timers.begin()->second));
+                timers.erase(timers.begin());
+            }
+            for (auto const & fn : out) fn();
+            fired += out.size();
+            for (std::size_t j = 0; j != out.size(); ++j) timers.emplace(now + d[(fired + j) % d.size()], []() {});
+        }
+        state.SetItemsProcessed(static_cast<std::int64_t>(fired));
+    }
+    BENCHMARK(BM_Multimap_Fire);
+}
@@ -0,0 +1,93 @@
+//
+// Created by dwd on 10/17/26.
+//
+
+#include <covent/loop.h>
+#include <covent/listener.h>
+#include <benchmark/benchmark.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Sending one large static payload to many sessions at once: copied into each session's output,
+// as write(string_view) does, or shared by reference between them all.
+
+namespace {
+    class Sink : public covent::Session {
+    public:
+        using covent::Session::Session;
+
+        covent::task<std::size_t> process(std::string_view data) override {
+            co_return data.size();
+        }
+    };
+
+    void fanout(benchmark::State & state, bool shared) {
+        auto const session_count = static_cast<std::size_t>(state.range(0));
+        auto const payload_size = static_cast<std::size_t>(state.range(1));
+        covent::Loop loop;
+        covent::Listener<Sink> listener(loop, "::1", 0); // Never listens; just a session factory.
+        std::vector<std::shared_ptr<Sink>> sessions;
+        std::vector<pollfd> peers;
+        for (std::size_t i = 0; i != session_count; ++i) {
+            int fds[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+                state.SkipWithError("socketpair failed");
+                return;
+            }
+            evutil_make_socket_nonblocking(fds[0]);
+            auto session = std::make_shared<Sink>(loop, fds[0], listener);
+            loop.add(session);
+            sessions.push_back(session);
+            peers.push_back({.fd = fds[1], .events = POLLIN});
+        }
+        std::atomic<std::size_t> received = 0;
+        std::atomic<bool> stop = false;
+        std::jthread reader([&peers, &received, &stop]() {
+            std::vector<char> scratch(1 << 16);
+            while (!stop) {
+                if (poll(peers.data(), peers.size(), 10) <= 0) continue;
+                for (auto & p : peers) {
+                    if (!(p.revents & POLLIN)) continue;
+                    auto n = ::recv(p.fd, scratch.data(), scratch.size(), MSG_DONTWAIT);
+                    if (n > 0) received += static_cast<std::size_t>(n);
+                }
+            }
+        });
+        auto payload = std::make_shared<std::string const>(payload_size, 'x');
+        std::size_t target = 0;
+        for (auto _ : state) {
+            for (auto & session : sessions) {
+                if (shared) {
+                    session->write(*payload, payload);
+                } else {
+                    session->write(*payload);
+                }
+            }
+            target += session_count * payload_size;
+            while (received < target) {
+                loop.run_once(false);
+                std::this_thread::yield();
+            }
+        }
+        stop = true;
+        reader.join();
+        for (auto & p : peers) ::close(p.fd);
+        state.SetBytesProcessed(static_cast<std::int64_t>(target));
+    }
+
+    void BM_Write_Fanout_Copy(benchmark::State & state) {
+        fanout(state, false);
+    }
+    BENCHMARK(BM_Write_Fanout_Copy)->Args({64, 256 << 10})->UseRealTime();
+
+    void BM_Write_Fanout_Shared(benchmark::State & state) {
+        fanout(state, true);
+    }
+    BENCHMARK(BM_Write_Fanout_Shared)->Args({64, 256 << 10})->UseRealTime();
+}
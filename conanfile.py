@@ -10,15 +10,19 @@ class ConanApplication(ConanFile):
 
     options = {
         "tests": [True, False],
+        "benchmarks": [True, False],
         "shared": [True, False],
+        "span_tracking": [True, False],
     }
     default_options = {
         "tests": False,
+        "benchmarks": False,
         "shared": False,
+        "span_tracking": True,
         "unbound/*:shared": False,
     }
 
-    exports_sources = "src/*", "CMakeLists.txt", "include/*", "test/*"
+    exports_sources = "src/*", "CMakeLists.txt", "include/*", "test/*", "bench/*"
 
     def validate(self):
         check_min_cppstd(self, "20")
@@ -31,7 +35,9 @@ class ConanApplication(ConanFile):
         deps.generate()
         tc = CMakeToolchain(self)
         tc.variables["COVENT_BUILD_TESTS"] = self.options.tests
+        tc.variables["COVENT_BUILD_BENCHMARKS"] = self.options.benchmarks
         tc.variables["BUILD_SHARED_LIBS"] = self.options.shared
+        tc.variables["COVENT_SPAN_TRACKING"] = self.options.span_tracking
         tc.user_presets_path = False
         tc.generate()
 
@@ -56,6 +62,8 @@ class ConanApplication(ConanFile):
             self.requires(requirement, headers=True)
         if self.options.tests:
             self.requires("gtest/1.12.1")
+        if self.options.benchmarks:
+            self.requires("benchmark/1.9.0")
 
     def package(self):
         tc = CMake(self)
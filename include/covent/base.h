@@ -9,6 +9,7 @@
 
 namespace covent {
     class Loop;
+    class LoopGroup;
     class Session;
     template<typename T, typename L=Loop>
     struct task;
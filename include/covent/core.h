@@ -6,12 +6,23 @@
 #define COVENT_CORE_H
 
 #include <event2/util.h>
+#include <event2/buffer.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
 #include <optional>
+#include <memory>
+#include <vector>
+#include <span>
+#include <string>
+#include <string_view>
 #include <functional>
 #include <sys/socket.h>
 #include <covent/coroutine.h>
 #include <covent/base.h>
 #include <covent/sockaddr-cast.h>
+#include <covent/socket-options.h>
 #include <sigslot/sigslot.h>
 #include <openssl/types.h>
 #include <spdlog/logger.h>
@@ -20,25 +31,107 @@ struct bufferevent;
 struct evconnlistener;
 
 namespace covent {
+    namespace detail {
+        class Relay;
+    }
+
+    // In seconds; zero is no limit.
+    struct Timeouts {
+        double idle = 0; // Nothing read or sent for this long.
+        double handshake = 0; // Connecting, or negotiating TLS after ssl().
+        double lifetime = 0; // From when they're set, however busy.
+    };
+    enum class Timeout {
+        idle, handshake, lifetime
+    };
+
+    // How Session::connect_any() races its addresses (RFC 8305).
+    struct ConnectPolicy {
+        double attempt_delay = 0.25; // Before starting the next attempt, unless the last fails sooner.
+        double timeout = 10; // For the whole race.
+        int preferred_family = AF_INET6; // Goes first, unless history says the other's quicker.
+        SocketOptions options = {};
+    };
+
+    // Limits on what a listener will take on. Zero is no limit.
+    struct Admission {
+        std::size_t max_sessions = 0; // Across every loop this listener accepts on.
+        double max_lag = 0; // Seconds; turns on Loop::measure_lag() for each loop listened on.
+        enum class Overload {
+            pause, // Stop accepting, leaving new connections in the kernel's backlog.
+            shed, // Accept, and hand straight to shed().
+        } overload = Overload::pause;
+        double recheck = 0.05; // How often a paused listener looks again.
+    };
+
     class ListenerBase {
     public:
-        ListenerBase(Loop & loop, std::string const & address, unsigned short port);
+        // An address starting with '/' is a Unix socket path, and one starting with '@' a name in the abstract
+        // namespace; for either, the port is ignored.
+        ListenerBase(Loop & loop, std::string const & address, unsigned short port, SocketOptions options = {});
 
         [[nodiscard]] const struct sockaddr * sockaddr() const;
-        void session_connected(evutil_socket_t sock, const struct sockaddr * addr, int len);
+        [[nodiscard]] SocketOptions const & socket_options() const {
+            return m_options;
+        }
+        // Applied to every Session created from here.
+        void timeouts(Timeouts const & t) {
+            m_timeouts = t;
+        }
+        [[nodiscard]] Timeouts const & timeouts() const {
+            return m_timeouts;
+        }
+        void admission(Admission const & a) {
+            m_admission = a;
+        }
+        [[nodiscard]] Admission const & admission() const {
+            return m_admission;
+        }
+        struct AdmissionStats {
+            std::uint64_t accepted = 0;
+            std::uint64_t shed = 0;
+            std::uint64_t paused = 0; // Times accepting was paused, rather than connections.
+            std::size_t sessions = 0; // Live right now.
+        };
+        [[nodiscard]] AdmissionStats admission_stats() const;
+        void session_connected(Loop & loop, evutil_socket_t sock, const struct sockaddr * addr, int len);
         void listen(Loop &);
+        void listen(LoopGroup &); // Bind a SO_REUSEPORT socket on each loop; the kernel spreads connections across them. Not for Unix sockets.
 
         virtual void create_session(evutil_socket_t) = 0;
+        // Called on the loop which accepted the connection.
+        virtual void create_session(Loop &, evutil_socket_t sock) {
+            create_session(sock);
+        }
+        // A connection turned away by admission control. Send whatever rejection the protocol has, if it
+        // can be done without blocking; by default, it's just closed.
+        virtual void shed(Loop &, evutil_socket_t sock);
         Loop & loop() {
             return m_loop;
         }
         virtual ~ListenerBase();
 
     private:
+        friend class Session;
+        struct Shard;
+        Shard & bind(Loop &, bool reuse_port);
+        static void accept_cb(struct evconnlistener *, evutil_socket_t sock, struct sockaddr * addr, int len, void * arg);
+        [[nodiscard]] bool admit(Loop &) const;
+        void pause(Shard &);
+        void recheck(Shard &);
+
         Loop & m_loop;
         unsigned short m_port;
         struct sockaddr_storage m_sockaddr;
-        struct evconnlistener * m_listener = nullptr;
+        SocketOptions m_options;
+        Timeouts m_timeouts;
+        Admission m_admission;
+        // Shared with the sessions, which may well outlive us. Everything else is only touched on the loops.
+        std::shared_ptr<std::atomic<std::size_t>> m_sessions = std::make_shared<std::atomic<std::size_t>>(0);
+        std::atomic<std::uint64_t> m_accepted = 0;
+        std::atomic<std::uint64_t> m_shed = 0;
+        std::atomic<std::uint64_t> m_paused = 0;
+        std::vector<std::unique_ptr<Shard>> m_shards;
     };
 
     class Session : public sigslot::has_slots {
@@ -53,9 +146,50 @@ namespace covent {
 
         using id_type = uint64_t;
 
+        using segments_type = std::span<std::string_view const>;
+
         // Consume whatever data you can from the buffer. If that's actually none of it, immediately return 0.
         // Anything you do consume, return the number of octets you used (this will destroy buffers).
-        virtual task<std::size_t> process(std::string_view data) = 0;
+        virtual task<std::size_t> process(std::string_view data);
+        // Scatter-read alternative, used instead once scatter_read() is switched on: the input buffer's
+        // segments as they stand, without copying them together. Consume across segments as you like,
+        // and return the total used, as above. The segments stay valid until then, unless you call contiguous().
+        virtual task<std::size_t> process_segments(segments_type data);
+
+        // Stream mode: instead of process() being called for each arrival, one long-running reader coroutine
+        // pulls input as it wants it. What a read returns is consumed, and only valid until the next read.
+        // At end of stream, read_some() returns an empty view and the others throw.
+        struct read_awaiter {
+            static constexpr bool no_loop_resume = true;
+            Session & session;
+            std::size_t octets = 0;
+            std::string_view delimiter = {};
+
+            [[nodiscard]] bool await_ready() const {
+                return session.reader_ready(*this);
+            }
+            template<typename P>
+            void await_suspend(std::coroutine_handle<P> h) const {
+                session.m_reader_waiting = task_ref(h);
+            }
+            [[nodiscard]] std::string_view await_resume() const {
+                return session.reader_take(*this);
+            }
+            auto & operator co_await() const {
+                return *this;
+            }
+        };
+        [[nodiscard]] read_awaiter read_some() {
+            return {*this};
+        }
+        [[nodiscard]] read_awaiter read_exact(std::size_t octets) {
+            return {*this, octets};
+        }
+        [[nodiscard]] read_awaiter read_until(std::string_view delimiter) {
+            return {*this, 0, delimiter};
+        }
+        // Hand all input to this reader from now on. The Session closes when it finishes.
+        void start_reader(task<void> reader);
 
         // Default behaviour when the other end is closed is to simply close the session.
         virtual void closed() {
@@ -63,43 +197,209 @@ namespace covent {
         }
 
         void write(std::string_view data); // Fire and forget writing.
-        [[nodiscard]] task<void> flush(std::string_view data = {}); // Awaitable writing.
+        void write(std::span<std::string_view const> data); // Gathered into the output in one go.
+        // Zero-copy: the output refers to data in place, keeping owner alive until it's been sent.
+        void write(std::string_view data, std::shared_ptr<void const> owner);
+        void write(struct evbuffer * data); // Moves everything out of data, without copying.
+        // Send length octets of the file from offset (or to its end if negative). Plain sockets use
+        // sendfile, TLS maps the file in. Takes its own copy of fd, so the caller may close theirs.
+        void write_file(int fd, ev_off_t offset = 0, ev_off_t length = -1);
+        [[nodiscard]] task<void> flush(std::string_view data = {}); // Awaitable writing; done once this has drained.
+
+        // Output progress: flush() waits for the output to drain past where its data ended, and write_ready()
+        // waits while more than the high watermark is queued, until it's drained to half that. Either throws
+        // if the connection fails first.
+        struct write_awaiter {
+            static constexpr bool no_loop_resume = true;
+            Session & session;
+            std::uint64_t offset = 0; // Octets written since the start.
+            bool watermark = false; // Wait on the high watermark instead.
+
+            [[nodiscard]] bool await_ready() const {
+                return session.writer_ready(*this);
+            }
+            template<typename P>
+            void await_suspend(std::coroutine_handle<P> h) const {
+                session.writer_wait(*this, task_ref(h));
+            }
+            void await_resume() const {
+                session.writer_resume(*this);
+            }
+            auto & operator co_await() const {
+                return *this;
+            }
+        };
+        [[nodiscard]] write_awaiter write_ready() {
+            return {*this, 0, true};
+        }
+        // Buffer caps. Above the output watermark, the session also stops reading until it's drained to half;
+        // the input watermark stops reading until process() has used some. Zero, the default, is unbounded.
+        void output_watermark(std::size_t high);
+        void input_watermark(std::size_t high);
+        [[nodiscard]] std::size_t output_pending() const; // Octets queued but not yet sent.
+        [[nodiscard]] std::size_t buffered() const { // Octets held in input and output.
+            return m_buffered;
+        }
         [[nodiscard]] SSL * ssl() const;
         sigslot::signal<> & ssl(SSL * s, bool connecting);
 
-        task<void> connect(const struct sockaddr *, size_t);
+        task<void> connect(const struct sockaddr *, size_t, SocketOptions const & options = {});
         template<typename S>
-        auto connect(S * addr) {
+        auto connect(S * addr, SocketOptions const & options = {}) {
             auto * base_addr = sockaddr_cast<AF_UNSPEC>(addr);
-            return connect(base_addr, sizeof(S));
+            return connect(base_addr, sockaddr_len(addr), options);
         }
+        // Happy Eyeballs: try each address in turn, alternating families and starting the next every attempt_delay
+        // without waiting for the last, and keep whichever connects first. Returns its index.
+        task<std::size_t> connect_any(std::span<struct sockaddr_storage const> addresses, ConnectPolicy policy = {});
+        void socket_options(SocketOptions const & options); // Retune the connected socket.
+        void timeouts(Timeouts const & t);
+        // Called when a timeout expires. By default, throws away any unsent output and closes.
+        virtual void timed_out(Timeout reason);
         void close();
 
         bufferevent *eject();
 
+        // Move to another Loop, connection, buffers, TLS state and all: co_await migrate(target) and the
+        // awaiting coroutine carries on on the target's thread. Only that coroutine is rebound - anything
+        // further up its chain, or scheduled on the old loop, stays where it was - and nothing else may be
+        // waiting on the session's reads or writes. Not during a TLS handshake, either.
+        struct migrate_awaiter {
+            static constexpr bool no_loop_resume = true;
+            Session & session;
+            Loop & target;
+
+            [[nodiscard]] bool await_ready() const {
+                return &target == session.m_loop;
+            }
+            template<typename P>
+            void await_suspend(std::coroutine_handle<P> h) const {
+                Loop * previous = nullptr;
+                if constexpr (requires { h.promise().loop = &target; }) {
+                    previous = std::exchange(h.promise().loop, &target);
+                }
+                try {
+                    session.migrate_start(target, [h]() {
+                        if constexpr (std::derived_from<P, detail::promise_base>) h.promise().restack();
+                        h.resume();
+                    });
+                } catch (...) {
+                    if constexpr (requires { h.promise().loop = &target; }) h.promise().loop = previous;
+                    throw;
+                }
+            }
+            void await_resume() const {}
+        };
+        [[nodiscard]] migrate_awaiter migrate(Loop & target) {
+            return {*this, target};
+        }
+
         [[nodiscard]] id_type id() const {
             return m_id;
         }
 
         [[nodiscard]] Loop & loop() const {
-            return m_loop;
+            return *m_loop;
         }
 
         void used(size_t len);
+        // Pull up the first len octets of input into one contiguous block, for protocols that need it.
+        [[nodiscard]] std::string_view contiguous(std::size_t len);
         void read_cb(struct bufferevent * bev);
         void write_cb(struct bufferevent * bev);
         void event_cb(struct bufferevent * bev, short flags);
         void processing_complete();
     private:
+        friend class Loop;
+        friend class detail::Relay;
         id_type m_id;
-        Loop & m_loop;
+        Loop * m_loop; // Only changes on migration.
         bool m_closing = false;
         // Only need to track the top one.
         struct bufferevent * m_top = nullptr;
         std::optional<task<std::size_t>> m_processor;
+        bool m_scatter = false;
+        std::vector<std::string_view> m_segments;
+        std::vector<evbuffer_iovec> m_iovecs;
+        std::size_t m_anchor = 0; // Offset of the last segment, if m_anchored.
+        bool m_anchored = false;
         sigslot::signal<> connected;
-        sigslot::signal<> written;
+        // Running totals for the top output, kept by an evbuffer callback, against which flushes are measured.
+        std::uint64_t m_enqueued = 0;
+        std::uint64_t m_drained = 0;
+        struct evbuffer_cb_entry * m_output_cb = nullptr;
+        struct evbuffer_cb_entry * m_input_cb = nullptr;
+        std::size_t m_buffered = 0; // As reported to the Loop.
+        std::size_t m_high_watermark = 0;
+        std::size_t m_input_cap = 0;
+        std::size_t m_write_low = 0; // As currently set on m_top.
+        bool m_write_failed = false;
+        // Waiters are held by task_ref, so any destroyed while suspended are skipped rather than resumed.
+        std::deque<std::pair<std::uint64_t, task_ref>> m_flushes; // In offset order.
+        std::vector<task_ref> m_write_ready_waiting;
+        bool writer_ready(write_awaiter const &) const;
+        void writer_wait(write_awaiter const &, task_ref waiter);
+        void writer_resume(write_awaiter const &) const;
+        void writer_wake();
+        void watch_buffers();
+        void unwatch_buffers();
+        void update_write_watermark();
+        void update_read_watermark();
+        static void output_cb(struct evbuffer *, struct evbuffer_cb_info const *, void *);
+        static void input_cb(struct evbuffer *, struct evbuffer_cb_info const *, void *);
+        void buffer_change(struct evbuffer_cb_info const *);
+        // Reasons reading is paused; it resumes when there are none left.
+        static constexpr unsigned pause_output = 1;
+        static constexpr unsigned pause_budget = 2;
+        static constexpr unsigned pause_input = 4;
+        static constexpr unsigned pause_relay = 8;
+        unsigned m_read_paused = 0;
+        void pause_reading(unsigned reason);
+        void resume_reading(unsigned reason);
+        // Timeouts are kept in the Loop's reaper ticks. Activity just notes the tick; the reaper works out
+        // what's actually due when it gets to us.
+        Timeouts m_timeouts;
+        std::uint64_t m_start_tick = 0;
+        std::uint64_t m_active_tick = 0;
+        std::uint64_t m_handshake_tick = 0;
+        bool m_handshaking = false;
+        std::uint64_t m_reap_at = 0; // Tick we're due to be looked at, if any.
+        std::shared_ptr<std::atomic<std::size_t>> m_listener_sessions; // Our listener's count, if we came from one.
+        [[nodiscard]] std::optional<std::pair<std::uint64_t, Timeout>> next_timeout() const;
+        void update_reap();
+        void reap_check(std::uint64_t tick);
+        void handshaking(bool on);
+        void mark_active();
+        void migrate_start(Loop & target, std::function<void()> && resume);
+        void migrate_detach(std::shared_ptr<Session> const & self, Loop & target, std::function<void()> && resume);
+        void migrate_attach(std::shared_ptr<Session> const & self, evutil_socket_t fd, SSL * ssl, std::array<struct evbuffer *, 4> buffers, std::array<double, 3> ages);
+        detail::Relay * m_relay = nullptr; // Handles all our I/O, while set.
+        std::optional<task<void>> m_reader;
+        task_ref m_reader_waiting; // Skipped if it's been destroyed meanwhile.
+        std::size_t m_reader_extent = 0;
+        bool m_reader_have = false; // What the waiting read wants has arrived.
+        std::string_view m_reader_result;
+        std::size_t m_reader_consumed = 0; // Handed out by earlier reads, but not yet drained.
+        bool m_eof = false;
+        bool reader_ready(read_awaiter const &);
+        std::string_view reader_take(read_awaiter const &);
+        void reader_wake();
+        void reader_complete();
+        std::size_t m_need_octets = 0;
+        std::string m_need_delimiter;
+        std::size_t m_delimiter_scanned = 0; // Octets known not to start the delimiter.
+        bool have_needed(std::size_t & extent); // Extent is how far in the hint was satisfied, if there was one.
+        void read_contiguous();
+        void read_scatter();
+        bool peek_segments();
     protected:
+        void scatter_read(bool on = true) {
+            m_scatter = on;
+        }
+        // Hints for when process() comes up short: don't call it again until at least this many octets are
+        // buffered, or until the delimiter has arrived. Dropped again once satisfied.
+        void need_octets(std::size_t octets);
+        void need_delimiter(std::string_view delimiter);
         std::shared_ptr<spdlog::logger> m_log;
     };
 }
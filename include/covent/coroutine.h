@@ -15,8 +15,15 @@
 #include <optional>
 #include <memory>
 #include <stack>
+#include <functional>
+#include <concepts>
+#include <utility>
+#include <atomic>
+#include <cstring>
+#include <new>
 #include <sigslot/sigslot.h>
 #include <covent/sentry.h>
+#include <covent/frame-pool.h>
 
 namespace covent {
     // Usage: auto & my_promise = co_await own_promise<covent::task<bool>::promise_type>();
@@ -75,43 +82,136 @@ namespace covent {
 
     namespace detail {
         struct promise_base;
+    }
+
+    /**
+     * Weak reference to a coroutine, to check it's still alive before resuming it.
+     *
+     * For covent's own coroutines this compares against the generation in the frame's header, so
+     * it's a couple of words, costs nothing to create or copy, and never allocates. Any other
+     * coroutine handle is assumed to stay alive.
+     */
+    class task_ref {
+    public:
+        task_ref() = default;
+        explicit task_ref(std::coroutine_handle<> h) : m_handle(h) {}
+        template<typename P>
+        requires std::derived_from<P, detail::promise_base>
+        explicit task_ref(std::coroutine_handle<P> h) : m_handle(h), m_generation(detail::frame_generation(h.address())), m_checked(true) {}
+
+        [[nodiscard]] bool alive() const {
+            if (!m_handle) return false;
+            return !m_checked || detail::frame_alive(m_handle.address(), m_generation);
+        }
+        explicit operator bool() const {
+            return alive();
+        }
+        [[nodiscard]] std::coroutine_handle<> handle() const {
+            return m_handle;
+        }
+
+    private:
+        std::coroutine_handle<> m_handle;
+        std::uint32_t m_generation = 0;
+        bool m_checked = false;
+    };
+
+    namespace detail {
+#ifndef COVENT_NO_SPAN_TRACKING
         class Stack {
         public:
             static inline thread_local std::weak_ptr<Stack> thread_stack = {};
+            static inline thread_local bool thread_tracked = false; // Cheap check for thread_stack being set.
             std::weak_ptr<sentry::span> current_top = {};
             std::weak_ptr<sentry::transaction> transaction = {}; // Transaction for this stack, if any.
             promise_base * current_promise;
+
+            // See sentry::set_tracking.
+            static inline std::atomic<sentry::tracking> mode = sentry::tracking::on;
+            static inline std::atomic<unsigned> sample_every = 64;
+            static inline thread_local unsigned sample_count = 0;
+
+            // Should a new root task get a Stack?
+            static bool track_new() {
+                switch (mode.load(std::memory_order_relaxed)) {
+                    case sentry::tracking::off:
+                        return false;
+                    case sentry::tracking::sampled:
+                        return ++sample_count % sample_every.load(std::memory_order_relaxed) == 0;
+                    default:
+                        return true;
+                }
+            }
+        };
+#endif
+
+        // Something to do once a task completes: a plain function and its context, so setting one never
+        // allocates. A promise holds the first itself; any more are linked in after it.
+        struct continuation {
+            void (*fn)(void *) = nullptr;
+            void * context = nullptr;
+            continuation * next = nullptr;
+            bool owned = false; // Allocated by set_continuation, rather than supplied by the caller.
         };
 
         struct promise_base {
             std::exception_ptr eptr;
             std::coroutine_handle<> parent;
-            std::shared_ptr<Stack> stack;
+#ifndef COVENT_NO_SPAN_TRACKING
+            std::shared_ptr<Stack> stack; // Null if this task tree isn't tracked.
             std::weak_ptr<sentry::span> span;
-            sigslot::signal<> completed;
-            /**
-             * Double duty - a boolean that indicates if the coroutine has been started, and
-             * also a shared_ptr to check (via weak_ptr) if the coroutine remains alive.
-             * Only keep a weak_ptr ref to this!
-             */
-            std::shared_ptr<bool> liveness = std::make_shared<bool>(false);
+#endif
+            continuation completion; // Called on completion, before the parent resumes.
+            bool started = false;
+
+            promise_base() = default;
+            promise_base(promise_base const &) = delete;
+            ~promise_base() {
+                // Any we allocated that never got to run.
+                for (auto * c = completion.next; c;) {
+                    auto * next = c->next;
+                    if (c->owned) delete c;
+                    c = next;
+                }
+            }
+
+            // Coroutine frames come from a per-thread pool rather than the general heap.
+            static void * operator new(std::size_t size) {
+                return frame_allocate(size);
+            }
+            static void operator delete(void * ptr, std::size_t size) noexcept {
+                frame_deallocate(ptr, size);
+            }
 
             std::suspend_always initial_suspend() {
-                this->stack = Stack::thread_stack.lock();
-                if (!this->stack) {
+#ifndef COVENT_NO_SPAN_TRACKING
+                if (Stack::thread_tracked) this->stack = Stack::thread_stack.lock();
+                if (!this->stack && Stack::track_new()) {
                     stack = std::make_shared<Stack>();
                     restack();
                 }
+#endif
                 return {};
             }
 
             void restack() const {
+#ifndef COVENT_NO_SPAN_TRACKING
+                if (!this->stack) {
+                    // Untracked; just make sure nothing started here picks up someone else's stack.
+                    if (Stack::thread_tracked) {
+                        Stack::thread_stack.reset();
+                        Stack::thread_tracked = false;
+                    }
+                    return;
+                }
                 Stack::thread_stack = this->stack;
+                Stack::thread_tracked = true;
                 this->stack->current_promise = const_cast<promise_base *>(this);
                 auto span = this->span.lock();
                 if (span) {
                     this->stack->current_top = span;
                 }
+#endif
             }
 
             struct final_awaiter
@@ -121,19 +221,25 @@ namespace covent {
                 template<typename P>
                 std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept
                 {
-                    h.promise().completed.emit();
-                    if (auto parent = h.promise().parent; parent) {
+                    // The continuation may hand us to another thread, which might destroy this frame: so
+                    // nothing in it is touched once that's been called.
+                    auto parent = h.promise().parent;
+                    if (h.promise().completion.fn) run_continuations(std::exchange(h.promise().completion, {}));
+                    if (parent) {
                         return parent;
                     }
                     return std::noop_coroutine();
                 }
             };
             [[nodiscard]] final_awaiter final_suspend() const noexcept {
+#ifndef COVENT_NO_SPAN_TRACKING
+                if (!this->stack) return {};
                 auto span = this->span.lock();
                 if (span && (span.get() == this->stack->current_top.lock().get())) {
                     this->stack->current_top = span->parent();
                 }
                 this->stack->current_promise = nullptr;
+#endif
                 return {};
             }
 
@@ -145,6 +251,58 @@ namespace covent {
                 if (eptr) std::rethrow_exception(eptr);
             }
         };
+        // Continuations run in the order they were set, all before the parent resumes.
+        // In the order they were set. Nodes are finished with before their function is called, since that
+        // might free them.
+        inline void run_continuations(continuation first) noexcept {
+            auto * next = first.next;
+            first.fn(first.context);
+            while (next) {
+                auto c = *next;
+                if (c.owned) delete next;
+                next = c.next;
+                c.fn(c.context);
+            }
+        }
+        // Link in a node the caller owns, which must outlive the task's completion.
+        inline void set_continuation(promise_base & p, continuation & node) {
+            node.next = nullptr;
+            if (!p.completion.fn) {
+                p.completion.fn = node.fn;
+                p.completion.context = node.context;
+                return;
+            }
+            auto * tail = &p.completion;
+            while (tail->next) tail = tail->next;
+            tail->next = &node;
+        }
+        // The first is held in the promise; only further ones need a node allocating.
+        inline void set_continuation(promise_base & p, void (*fn)(void *), void * context) {
+            if (!p.completion.fn) {
+                p.completion.fn = fn;
+                p.completion.context = context;
+                return;
+            }
+            set_continuation(p, *new continuation{fn, context, nullptr, true});
+        }
+        template<auto Fn, typename O>
+        void set_continuation(promise_base & p, O * obj) {
+            set_continuation(p, [](void * o) {
+                (static_cast<O *>(o)->*Fn)();
+            }, obj);
+        }
+        // A callable small enough to be carried as the context itself: a lambda capturing nothing, or a single
+        // pointer, reference or handle.
+        template<typename F, typename Fn = std::decay_t<F>>
+        requires std::is_trivially_copyable_v<Fn> && (sizeof(Fn) <= sizeof(void *)) && (alignof(Fn) <= alignof(void *))
+        void set_continuation(promise_base & p, F && f) {
+            void * context = nullptr;
+            std::memcpy(&context, &f, sizeof(Fn));
+            set_continuation(p, [](void * c) {
+                (*std::launder(reinterpret_cast<Fn *>(&c)))();
+            }, context);
+        }
+
         template<typename T> concept reference = std::is_reference_v<T>;
         template<typename T> concept refreference = std::is_rvalue_reference_v<T>;
         template<typename T> concept pointer = std::is_pointer_v<T>;
@@ -347,7 +505,7 @@ namespace covent {
                 if (task.handle.done()) {
                     return coro;
                 }
-                if (*task.handle.promise().liveness) {
+                if (task.handle.promise().started) {
                     // Already started, but presumably suspended, so do nothing.
                     return std::noop_coroutine();
                 }
@@ -365,7 +523,7 @@ namespace covent {
         handle_type handle = nullptr;
 
         bool start() const { // NOLINT
-            *handle.promise().liveness = true;
+            handle.promise().started = true;
             handle.promise().restack();
             handle.resume();
             return handle.done();
@@ -379,9 +537,13 @@ namespace covent {
             }
             return handle.promise().get();
         }
+        template<auto Fn, typename O>
+        void on_completed(O * obj) {
+            detail::set_continuation<Fn>(this->handle.promise(), obj);
+        }
         template<typename... Args>
-        auto on_completed(Args... a) {
-            return this->handle.promise().completed.connect(a...);
+        void on_completed(Args &&... a) {
+            detail::set_continuation(this->handle.promise(), std::forward<Args>(a)...);
         }
 
         instant_task() = default;
@@ -401,7 +563,7 @@ namespace covent {
         }
 
         handle_type resume_handle() const {
-            *handle.promise().liveness = true;
+            handle.promise().started = true;
             return handle;
         }
     };
@@ -419,9 +581,15 @@ namespace covent {
             explicit await_transformer_base(covent::temp<A&> && a) : real(std::move(a)) {}
 
             void resume(std::coroutine_handle<P> coro, covent::instant_task<void>::promise_type & p) {
-                // TODO: Shuffle virtual callstack, schedule call.
-                auto handle = coro.promise().resume_handle(coro);
-                p.parent = handle;
+                if (coro.promise().same_loop()) {
+                    p.parent = coro.promise().resume_handle(coro);
+                    return;
+                }
+                // Posting the parent back to its own Loop has to wait until we're at our final suspend, or it
+                // might find us - the runner it reads the result from and then destroys - still running.
+                set_continuation(p, [coro]() {
+                    coro.promise().resume_handle(coro);
+                });
             }
 
             auto await_ready() const {
@@ -474,6 +642,37 @@ namespace covent {
             }
         };
 
+        // Awaiting a task: if it's bound to the same Loop as the awaiting coroutine, just hand over directly -
+        // no wrapper coroutine, no copy of the result. Otherwise fall back to the wrapper, which hops Loops.
+        template<typename T, typename P>
+        struct task_transformer : public await_transformer<T, P> {
+            using base = await_transformer<T, P>;
+            using base::base;
+            bool direct = false;
+            std::coroutine_handle<P> parent = nullptr;
+
+            bool await_ready() {
+                return this->real.value().handle.done();
+            }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<P> coro) {
+                auto & t = this->real.value();
+                if (t.handle.promise().loop == coro.promise().loop) {
+                    direct = true;
+                    parent = coro;
+                    return task_awaiter<T>{t}.await_suspend(coro);
+                }
+                return base::await_suspend(coro);
+            }
+            typename base::value_type await_resume() {
+                // The task's final suspend hands straight back to us, leaving its own stack current.
+                if (direct) parent.promise().restack();
+                if (direct || !this->runner.handle) {
+                    return this->real.value().handle.promise().get();
+                }
+                return base::await_resume();
+            }
+        };
+
         // Force the loop into a template parameter to side-step needing to declare it fully.
         template<typename R, typename L=Loop>
         struct wrapped_promise : promise<R> {
@@ -488,16 +687,14 @@ namespace covent {
             }
             std::coroutine_handle<> resume_handle(std::coroutine_handle<wrapped_promise> mine) const {
                 if (same_loop()) {
-                    *this->liveness = true;
+                    const_cast<wrapped_promise *>(this)->started = true;
                     this->restack();
                     return mine;
                 } else {
                     auto * l = loop;
-                    std::weak_ptr<bool> alive = this->liveness;
-
-                    l->defer([handle=mine, alive](){
-                        if (auto liveness = alive.lock(); liveness) {
-                            *handle.promise().liveness = true;
+                    l->post([handle=mine, ref=task_ref(mine)](){
+                        if (ref.alive()) {
+                            handle.promise().started = true;
                             handle.promise().restack();
                             handle.resume();
                         }
@@ -517,6 +714,19 @@ namespace covent {
                 return a;
             }
 
+            template<typename V, typename L2>
+            auto await_transform(task<V, L2> & t) const {
+                covent::temp<task<V, L2> &> tt;
+                tt.assign(t);
+                return task_transformer<task<V, L2>, wrapped_promise<R>>{std::move(tt)};
+            }
+            template<typename V, typename L2>
+            auto await_transform(task<V, L2> const & t) const {
+                covent::temp<task<V, L2> const &> tt;
+                tt.assign(t);
+                return task_transformer<const task<V, L2>, wrapped_promise<R>>{std::move(tt)};
+            }
+
             template<typename A>
             auto await_transform(A & a) const {
                 covent::temp<A &> aa;
@@ -576,9 +786,13 @@ namespace covent {
         auto operator co_await() const {
             return detail::task_awaiter(*this);
         }
+        template<auto Fn, typename O>
+        void on_completed(O * obj) {
+            detail::set_continuation<Fn>(this->handle.promise(), obj);
+        }
         template<typename... Args>
-        auto on_completed(Args... a) {
-           return this->handle.promise().completed.connect(a...);
+        void on_completed(Args &&... a) {
+            detail::set_continuation(this->handle.promise(), std::forward<Args>(a)...);
         }
     };
 }
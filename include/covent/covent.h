@@ -5,5 +5,6 @@
 #include <covent/coroutine.h>
 #include <covent/loop.h>
 #include <covent/listener.h>
+#include <covent/loop-group.h>
 
 #endif //COEVENT_COVENT_H
@@ -0,0 +1,149 @@
+//
+// Created by dwd on 10/17/26.
+//
+
+#ifndef COVENT_DATAGRAM_H
+#define COVENT_DATAGRAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <coroutine>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <sys/socket.h>
+#include <event2/util.h>
+#include <covent/coroutine.h>
+#include <covent/socket-options.h>
+
+struct event;
+
+namespace covent {
+    class Loop;
+
+    // One datagram, either way. Received, peer points into the batch it came in; sending, it can be null
+    // if the endpoint's connected.
+    struct Datagram {
+        std::string_view data;
+        struct sockaddr const * peer = nullptr;
+    };
+
+    struct DatagramOptions {
+        std::size_t batch = 32; // Datagrams read per recvmmsg.
+        std::size_t max_size = 2048; // Largest datagram expected; anything longer is truncated (and counted).
+        // Ask for UDP_GRO, where the kernel has it, so a run of same-sized datagrams from one peer arrives
+        // in a single slot. Each slot then has room for a full 64KiB.
+        bool gro = true;
+        bool gso = true; // Coalesce sends with UDP_SEGMENT where possible.
+        SocketOptions options; // Only the non-TCP ones make sense here.
+    };
+
+    namespace detail {
+        struct DatagramPool;
+        struct DatagramBlock;
+    }
+
+    /**
+     * What one recv_batch() returned. The data and peers stay valid for as long as the batch does; when it's
+     * destroyed, its buffers go back to the endpoint's pool to be read into again. Destroy it on the endpoint's
+     * loop thread.
+     */
+    class DatagramBatch {
+    public:
+        DatagramBatch();
+        DatagramBatch(DatagramBatch &&) noexcept;
+        DatagramBatch & operator=(DatagramBatch &&) noexcept;
+        ~DatagramBatch();
+
+        [[nodiscard]] auto begin() const {
+            return m_datagrams.begin();
+        }
+        [[nodiscard]] auto end() const {
+            return m_datagrams.end();
+        }
+        [[nodiscard]] std::size_t size() const {
+            return m_datagrams.size();
+        }
+        [[nodiscard]] bool empty() const {
+            return m_datagrams.empty();
+        }
+        Datagram const & operator[](std::size_t i) const {
+            return m_datagrams[i];
+        }
+
+    private:
+        friend class DatagramEndpoint;
+        std::shared_ptr<detail::DatagramPool> m_pool;
+        std::unique_ptr<detail::DatagramBlock> m_block;
+        std::vector<Datagram> m_datagrams;
+    };
+
+    /**
+     * A UDP (or Unix datagram) socket on a Loop. Reads come in batches through recvmmsg into pooled
+     * buffers; sends go out through sendmmsg, with runs of same-sized datagrams to one peer handed to
+     * the kernel as a single GSO send when it allows. Until the endpoint's connected, and so has a path
+     * MTU to go by, only datagrams that fit a 1500 octet MTU are coalesced.
+     *
+     * Only one coroutine may be waiting to receive, and one to send, at a time.
+     */
+    class DatagramEndpoint {
+    public:
+        struct Stats {
+            std::uint64_t received = 0; // Datagrams.
+            std::uint64_t batches = 0; // recvmmsg calls that returned anything.
+            std::uint64_t coalesced = 0; // Received datagrams that came in as part of a GRO slot.
+            std::uint64_t truncated = 0;
+            std::uint64_t sent = 0; // Datagrams.
+            std::uint64_t send_calls = 0;
+        };
+
+        // Bound to address and port (zero for any free one). The address may also be a Unix socket, as for Listener.
+        DatagramEndpoint(Loop & loop, std::string const & address, unsigned short port, DatagramOptions options = {});
+        DatagramEndpoint(DatagramEndpoint const &) = delete;
+        ~DatagramEndpoint();
+
+        [[nodiscard]] struct sockaddr const * sockaddr() const; // Where we're bound, port and all.
+        [[nodiscard]] evutil_socket_t fd() const {
+            return m_fd;
+        }
+        [[nodiscard]] Stats const & stats() const {
+            return m_stats;
+        }
+        // Default destination for Datagrams without a peer; also filters out anyone else's.
+        void connect(struct sockaddr const * peer);
+
+        // Whatever's there right now, without waiting; possibly empty.
+        DatagramBatch try_recv();
+        // At least one datagram.
+        task<DatagramBatch> recv_batch();
+        // Sends as many as can go without blocking, returning how many did.
+        std::size_t try_send(std::span<Datagram const> datagrams);
+        // Sends them all, waiting for room where needed.
+        task<void> send_batch(std::span<Datagram const> datagrams);
+
+    private:
+        class ready;
+        static void ready_cb(evutil_socket_t, short, void *);
+        std::size_t send_some(std::span<Datagram const> datagrams);
+
+        Loop & m_loop;
+        DatagramOptions m_options;
+        evutil_socket_t m_fd = -1;
+        struct sockaddr_storage m_sockaddr = {};
+        bool m_connected = false;
+        bool m_gro = false;
+        bool m_gso = false;
+        std::size_t m_gso_segment = 0; // Largest datagram we'll coalesce.
+        std::size_t m_slot_size = 0;
+        std::shared_ptr<detail::DatagramPool> m_pool;
+        struct event * m_read_event = nullptr;
+        struct event * m_write_event = nullptr;
+        ready * m_reader = nullptr;
+        ready * m_writer = nullptr;
+        Stats m_stats;
+    };
+}
+
+#endif //COVENT_DATAGRAM_H
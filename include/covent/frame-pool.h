@@ -0,0 +1,33 @@
+//
+// Created by dwd on 10/17/26.
+//
+
+#ifndef COVENT_FRAME_POOL_H
+#define COVENT_FRAME_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace covent::detail {
+    /**
+     * Allocator for coroutine frames, used by promise_base's operator new/delete.
+     *
+     * Each thread keeps a freelist per size class. A frame freed on the thread which allocated it
+     * goes straight back onto that thread's list; one freed elsewhere (a task destroyed on a
+     * different Loop, say) is pushed onto the owning thread's lock-free remote list, which the
+     * owner reclaims next time it runs short.
+     *
+     * Pooled frame memory is never returned to the heap. That lets every frame carry a generation
+     * which is bumped when it's freed, and which can still be read safely afterwards - task_ref uses
+     * this to tell whether a coroutine is still alive. Frames too big for the pool (over 1MiB) are
+     * freed outright; their generations are kept in a registry instead, under a lock.
+     */
+    void * frame_allocate(std::size_t size);
+    void frame_deallocate(void * ptr, std::size_t size) noexcept;
+    // Frame must be the address of a live coroutine whose promise derives from promise_base.
+    std::uint32_t frame_generation(void const * frame) noexcept;
+    // Is the frame which had this generation still the same live coroutine? Safe once it's gone.
+    bool frame_alive(void const * frame, std::uint32_t generation) noexcept;
+}
+
+#endif //COVENT_FRAME_POOL_H
@@ -8,6 +8,7 @@
 #include <optional>
 #include <utility>
 #include <coroutine>
+#include <covent/coroutine.h>
 
 namespace covent {
     template<typename V>
@@ -37,8 +38,7 @@ namespace covent {
             if (await_ready()) {
                 return false;
             }
-            m_liveness = m_dummy;
-            m_coro = awaiting_coroutine;
+            m_ref = task_ref(awaiting_coroutine);
             return true;
         }
 
@@ -47,8 +47,7 @@ namespace covent {
             if (await_ready()) {
                 return false;
             }
-            m_liveness = awaiting_coroutine.promise().liveness;
-            m_coro = awaiting_coroutine;
+            m_ref = task_ref(awaiting_coroutine);
             return true;
         }
 
@@ -57,8 +56,7 @@ namespace covent {
             if (await_ready()) {
                 return false;
             }
-            m_liveness = awaiting_coroutine.promise().liveness;
-            m_coro = awaiting_coroutine;
+            m_ref = task_ref(awaiting_coroutine);
             return true;
         }
 
@@ -73,23 +71,18 @@ namespace covent {
             if (await_ready()) {
                 m_value.reset();
                 m_except = nullptr;
-                m_coro = nullptr;
+                m_ref = {};
             }
         }
     private:
         void gogogo() {
-            if (m_coro) {
-                auto liveness = m_liveness.lock();
-                if (liveness) {
-                    m_coro.resume();
-                }
+            if (m_ref.alive()) {
+                m_ref.handle().resume();
             }
         }
         std::optional<V> m_value;
         std::exception_ptr m_except;
-        mutable std::coroutine_handle<> m_coro = std::noop_coroutine();
-        mutable std::weak_ptr<bool> m_liveness = {};
-        std::shared_ptr<bool> m_dummy = std::make_shared<bool>(true);
+        mutable task_ref m_ref;
     };
     template<>
     class future<void> : public future<bool> {
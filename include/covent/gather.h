@@ -70,14 +70,14 @@ namespace covent {
         // Kick off by starting each task. If any finishes instantly, just return the result.
         covent::task<void> timer;
         for (auto & task : tasks) {
-            if (!*task.handle.promise().liveness && task.start()) {
+            if (!task.handle.promise().started && task.start()) {
                 co_return task.get();
             }
         }
         // We now have a bunch of tasks which are suspended, so we only want to await the first.
         auto dummy_task = detail::dummy();
         // Fake it starting.
-        *dummy_task.handle.promise().liveness = true;
+        dummy_task.handle.promise().started = true;
         // OK, that was weird. Now make it the parent of all the tasks passed in:
         for (auto & task : tasks) {
             task.handle.promise().parent = dummy_task.handle;
@@ -125,7 +125,7 @@ namespace covent {
     covent::task<R> race_pack(T timeout, F && f, Tasks &... tasks) {
         // Kick off by starting each task. If any finishes instantly, just return the result.
         covent::task<void> timer;
-        ((!*tasks.handle.promise().liveness && tasks.start()), ...);
+        ((!tasks.handle.promise().started && tasks.start()), ...);
         {
             auto *winner = detail::return_first_done(f, tasks...);
             if (winner) co_return winner->get();
@@ -133,7 +133,7 @@ namespace covent {
         // We now have a bunch of tasks which are suspended, so we only want to await the first.
         auto dummy_task = detail::dummy();
         // Fake it starting.
-        *dummy_task.handle.promise().liveness = true;
+        dummy_task.handle.promise().started = true;
         // OK, that was weird. Now make it the parent of all the tasks passed in:
         ((tasks.handle.promise().parent = dummy_task.handle), ...);
         if constexpr (!std::is_same_v<T, detail::forever>) {
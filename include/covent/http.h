@@ -57,6 +57,9 @@ struct bufferevent;
             std::string body;
             bool complete = false;
             bool request = false;
+            // When process() stops short, what it's waiting for, counted from the first octet it didn't use.
+            bool want_line = false;
+            std::size_t want_octets = 0;
 
             unsigned long process(std::string_view data);
             [[nodiscard]] std::string render_request(Method m) const;
@@ -141,7 +144,7 @@ struct bufferevent;
 
         private:
             class HTTPSession;
-            [[nodiscard]] covent::task<std::shared_ptr<HTTPSession>> connect(dns::answers::Address address, URI const & uri) const;
+            [[nodiscard]] covent::task<std::shared_ptr<HTTPSession>> connect(std::vector<struct sockaddr_storage> addresses, URI const & uri) const;
             [[nodiscard]] covent::task<std::shared_ptr<HTTPSession>> connect_v4(URI const & uri) const;
             [[nodiscard]] covent::task<std::shared_ptr<HTTPSession>> connect_v6(URI const & uri) const;
 
@@ -235,6 +238,8 @@ struct bufferevent;
         class Server {
         public:
             explicit Server(short unsigned int port, bool tls);
+            // Listen on a Unix socket instead; a leading '@' puts it in the abstract namespace.
+            Server(std::string const & path, bool tls);
             ~Server();
 
             [[nodiscard]] Endpoint & root() const {
@@ -249,11 +254,17 @@ struct bufferevent;
 			struct bufferevent * get_buffer_event(struct event_base *);
 			void request_handler(struct evhttp_request * req);
         private:
+            explicit Server(bool tls);
+
             std::unique_ptr<Service> m_service;
             std::unique_ptr<Endpoint> m_root;
             struct evhttp * m_server;
+            std::string m_path; // Socket file to remove when we're done.
             std::list<covent::task<void>> m_in_flight;
         };
+        // Reply with the contents of fd, honouring a single Range if asked. Returns the status sent.
+        // The file goes out by sendfile where the connection allows; fd may be closed straight after.
+        int send_file(struct evhttp_request * req, int fd, std::string_view content_type = {});
         namespace exception {
             class base : public std::runtime_error {
             public:
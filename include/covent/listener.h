@@ -13,9 +13,12 @@ namespace covent {
     template<typename T>
     class Listener : public covent::ListenerBase {
     public:
-        Listener(covent::Loop & l, std::string const & address, unsigned short p) : covent::ListenerBase(l, address, p) {}
+        Listener(covent::Loop & l, std::string const & address, unsigned short p, SocketOptions options = {}) : covent::ListenerBase(l, address, p, std::move(options)) {}
         void create_session(evutil_socket_t sock) override {
-            loop().add(std::make_shared<T>(loop(), sock, *this));
+            create_session(loop(), sock);
+        }
+        void create_session(covent::Loop & l, evutil_socket_t sock) override {
+            l.add(std::make_shared<T>(l, sock, *this));
         }
     };
 }
@@ -0,0 +1,74 @@
+//
+// Created by dwd on 10/17/26.
+//
+
+#ifndef COVENT_LOOP_GROUP_H
+#define COVENT_LOOP_GROUP_H
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <covent/base.h>
+#include <covent/coroutine.h>
+#include <covent/loop.h>
+
+namespace covent {
+    /**
+     * A fixed set of Loops, each running forever on its own thread, optionally pinned to a core.
+     *
+     * Work is placed on a member loop by binding it there - pass loop(n) or next() as the Loop&
+     * first argument of a task - and sessions accepted by a Listener given to listen() stay on
+     * the loop whose socket accepted them.
+     *
+     * The Loops themselves outlive their threads, and are only destroyed with the group, so
+     * anything bound to them (listeners, sessions) should be destroyed first.
+     */
+    class LoopGroup {
+    public:
+        explicit LoopGroup(std::size_t size = std::thread::hardware_concurrency(), bool pin = true);
+        LoopGroup(LoopGroup const &) = delete;
+        LoopGroup(LoopGroup &&) = delete;
+        ~LoopGroup();
+
+        [[nodiscard]] std::size_t size() const {
+            return m_loops.size();
+        }
+        [[nodiscard]] Loop & loop(std::size_t index) const;
+        Loop & next(); // Round-robin.
+
+        void listen(ListenerBase &); // One SO_REUSEPORT socket per member loop.
+        void shutdown(); // Stop every loop, and wait for the threads to finish.
+
+        // Run a task on whichever loop it's bound to, blocking until it completes.
+        // Must not be called from a member loop's own thread.
+        template<typename V>
+        V run_task(task<V> && t) {
+            auto & target = *t.handle.promise().loop;
+            if (target.on_loop_thread()) throw covent_logic_error("LoopGroup::run_task would block its own loop");
+            struct {
+                Loop & target;
+                std::promise<void> finished;
+            } done{target, {}};
+            target.post([&t, &done]() {
+                t.on_completed([d = &done]() {
+                    // We're inside final_suspend here; let it return before the caller can destroy the frame.
+                    d->target.post([d]() {
+                        d->finished.set_value();
+                    });
+                });
+                t.start();
+            });
+            done.finished.get_future().wait();
+            return t.get();
+        }
+
+    private:
+        std::vector<std::unique_ptr<Loop>> m_loops;
+        std::vector<std::jthread> m_threads;
+        std::atomic<std::size_t> m_next = 0;
+    };
+}
+
+#endif //COVENT_LOOP_GROUP_H
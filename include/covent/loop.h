@@ -7,43 +7,54 @@
 
 #include <covent/base.h>
 #include <covent/core.h>
+#include <covent/timer-wheel.h>
+#include <covent/run-queue.h>
+#include <covent/slot-map.h>
 #include <vector>
 #include <memory>
-#include <map>
 #include <functional>
 #include <optional>
 #include <mutex>
-#include <set>
+#include <atomic>
+#include <thread>
+#include <unordered_map>
+#include <array>
+#include <chrono>
 #include <event2/util.h>
 
 #include "pkix.h"
 
 struct event_base;
-
-template<>
-struct std::less<struct timeval> {
-    constexpr bool operator()(struct timeval const & t1, struct timeval const & t2) const {
-        if (t1.tv_sec == t2.tv_sec) return t1.tv_usec < t2.tv_usec;
-        return t1.tv_sec < t2.tv_sec;
-    }
-};
+struct event;
 
 namespace covent {
-    template<typename Id>
-    struct Compare {
-        using is_transparent = void;
-        bool operator()(typename Id::id_type id, std::shared_ptr<Id> const & o2) const {
-            return id < o2->id();
-        }
-        bool operator()(std::shared_ptr<Id> const & o1, typename Id::id_type id) const {
-            return o1->id() < id;
+    // Refers to a timer created by Loop::defer. Doesn't own it - dropping the handle leaves the timer running -
+    // but it can cancel or reschedule it for as long as the Loop exists. Handles to timers which have fired,
+    // or whose Loop has been destroyed, are inert; but a handle mustn't be used while its Loop is being destroyed
+    // on another thread.
+    class TimerHandle {
+    public:
+        TimerHandle() = default;
+        TimerHandle(Loop & loop, detail::TimerWheel::id_type id);
+
+        bool cancel(); // True if the timer was still pending.
+        bool reschedule(struct timeval seconds); // Ditto, but it now runs after this delay instead.
+        bool reschedule(long seconds) {
+            return reschedule({seconds, 0});
         }
-        bool operator()(std::shared_ptr<Id> const & o1, std::shared_ptr<Id> const & o2) const {
-            return o1->id() < o2->id();
+        bool reschedule(int seconds) {
+            return reschedule(static_cast<long>(seconds));
         }
-        bool operator()(typename Id::id_type i1, typename Id::id_type i2) const {
-            return i1 < i2;
+        bool reschedule(double seconds);
+        [[nodiscard]] bool pending() const;
+
+    private:
+        [[nodiscard]] bool live() const {
+            return m_loop && !m_alive.expired();
         }
+        Loop * m_loop = nullptr;
+        std::weak_ptr<void> m_alive; // Expires with the Loop.
+        detail::TimerWheel::id_type m_id = 0;
     };
 
     class Loop {
@@ -80,6 +91,9 @@ namespace covent {
         }
 
         void shutdown();
+        [[nodiscard]] bool stopped() const {
+            return m_shutdown;
+        }
 
         std::shared_ptr<Session> add(std::shared_ptr<Session> const &);
         template<typename SessionType, typename ...Args>
@@ -87,19 +101,76 @@ namespace covent {
         [[nodiscard]] std::shared_ptr<SessionType> add(Args && ...args) {
             return std::dynamic_pointer_cast<SessionType>(add(std::make_shared<SessionType>(args...)));
         }
-        [[nodiscard]] std::shared_ptr<Session> session(Session::id_type id) const;
+        [[nodiscard]] std::shared_ptr<Session> session(Session::id_type id) const; // Null if there's no such session.
+        [[nodiscard]] std::size_t session_count() const {
+            return m_sessions.size();
+        }
+        // Listeners stop admitting sessions to this loop once it has this many. Zero, the default, is unlimited.
+        void max_sessions(std::size_t n) {
+            m_max_sessions = n;
+        }
+        [[nodiscard]] std::size_t max_sessions() const {
+            return m_max_sessions;
+        }
         void remove(Session const & session);
         void remove(std::shared_ptr<Session> const & session);
 
         void listen(ListenerBase &);
 
-        void defer(std::function<void()> && fn);
-        void defer(std::function<void()> && fn, long seconds);
-        void defer(std::function<void()> && fn, int seconds) {
-            defer(std::move(fn), static_cast<long>(seconds));
+        // Run fn on this loop's thread as soon as possible. Lock-free, and safe to call from any thread; a sleeping
+        // loop is woken at most once however many calls are queued. Unlike defer(), this cannot be cancelled.
+        void post(std::function<void()> && fn);
+        [[nodiscard]] bool on_loop_thread() const {
+            return std::this_thread::get_id() == m_thread;
+        }
+
+        TimerHandle defer(std::function<void()> && fn);
+        TimerHandle defer(std::function<void()> && fn, long seconds);
+        TimerHandle defer(std::function<void()> && fn, int seconds) {
+            return defer(std::move(fn), static_cast<long>(seconds));
+        }
+        TimerHandle defer(std::function<void()> && fn, double seconds);
+        TimerHandle defer(std::function<void()> && fn, struct timeval seconds);
+
+        // What's sitting in session buffers, input and output. Read these on the Loop's thread.
+        struct MemoryStats {
+            std::size_t buffered = 0;
+            std::size_t peak = 0;
+            std::size_t paused = 0; // Sessions not being read from because of the budget.
+            std::uint64_t pauses = 0; // Times a session has been paused for it.
+        };
+        [[nodiscard]] MemoryStats const & memory() const {
+            return m_memory;
+        }
+        // Once buffers across all sessions exceed this, stop reading from the biggest until they're back
+        // down to three quarters of it. Zero, the default, is unlimited.
+        void memory_budget(std::size_t octets);
+
+        // Session timeouts are all checked from one coarse timer, ticking this often (in seconds) while any are
+        // set. They fire up to a tick late. Set this before any session has timeouts.
+        void reap_resolution(double seconds) {
+            m_reap_resolution = seconds;
         }
-        void defer(std::function<void()> && fn, double seconds);
-        void defer(std::function<void()> && fn, struct timeval seconds);
+        struct ReapStats {
+            std::uint64_t idle = 0;
+            std::uint64_t handshake = 0;
+            std::uint64_t lifetime = 0;
+        };
+        [[nodiscard]] ReapStats const & reaped() const {
+            return m_reaped;
+        }
+
+        // Sample how late timers are running, every interval seconds from now on. The probe is a timer like
+        // any other, so run_until_complete() won't finish once it's on.
+        void measure_lag(double interval = 0.05);
+        [[nodiscard]] double lag() const { // Smoothed, in seconds. Zero until measure_lag() is on.
+            return m_lag;
+        }
+
+        // Connect times seen by Session::connect_any(), smoothed per address and port. A failure counts as the
+        // whole timeout, and an attempt abandoned for a quicker one as at least as long as it had.
+        [[nodiscard]] std::optional<double> connect_rtt(struct sockaddr const * addr) const;
+        void connect_rtt(struct sockaddr const * addr, double seconds, bool floor = false); // Record one; a floor only ever raises it.
 
         struct event_base * event_base() {
             return m_event_base.get();
@@ -109,14 +180,60 @@ namespace covent {
         }
 
     private:
+        friend class TimerHandle;
+        friend class Session;
+        Session::id_type reserve_session_id();
+        void release_session_id(Session::id_type id);
         bool set_next_break();
+        void wake();
+        static void woken(evutil_socket_t, short, void *);
+        bool run_posted();
+        void buffered(std::size_t added, std::size_t removed); // Sessions report their buffers changing.
+        void shed();
+        void unpause(Session::id_type id); // A budget-paused session is going away.
+        [[nodiscard]] std::uint64_t reap_ticks(double seconds) const;
+        [[nodiscard]] std::uint64_t reap_clock() const; // The tick it is now, by the clock.
+        void reap_sync();
+        void reap_arm();
+        void reap_schedule(Session::id_type id, std::uint64_t tick);
+        void reap_cancel(Session::id_type id, std::uint64_t tick);
+        void reap_tick();
+        void lag_sample(std::chrono::steady_clock::time_point expected);
+        static struct timeval to_timeval(double seconds);
 
         std::unique_ptr<struct event_base, std::function<void(struct event_base *)>> m_event_base;
         std::unique_ptr<Service> m_http_service;
-        std::set<std::shared_ptr<Session>, Compare<Session>> m_sessions;
+        detail::SlotMap<std::shared_ptr<Session>> m_sessions;
         std::recursive_mutex m_scheduler_mutex;
-        std::multimap<struct timeval, std::function<void()>> m_pending_actions;
-        bool m_shutdown = false;
+        detail::TimerWheel m_timers;
+        detail::RunQueue m_run_queue;
+        MemoryStats m_memory;
+        std::size_t m_memory_budget = 0;
+        std::size_t m_shed_at = 0; // Next level at which to look for more sessions to pause.
+        std::vector<Session::id_type> m_budget_paused;
+        // The reaper: a single-level wheel of coarse ticks, each slot holding (session, tick) pairs. Anything
+        // further off than a turn just waits for the wheel to come round again. Ticks count from the epoch by
+        // the monotonic clock, and the timer only runs while there's something in the wheel.
+        double m_reap_resolution = 1.0;
+        std::chrono::steady_clock::time_point m_reap_epoch = std::chrono::steady_clock::now();
+        std::uint64_t m_reap_tick = 0;
+        std::array<std::vector<std::pair<Session::id_type, std::uint64_t>>, 64> m_reap_slots;
+        std::size_t m_reap_pending = 0;
+        TimerHandle m_reap_timer;
+        ReapStats m_reaped;
+        std::size_t m_max_sessions = 0;
+        double m_lag_interval = 0;
+        double m_lag = 0;
+        TimerHandle m_lag_timer;
+        std::shared_ptr<void> m_alive = std::make_shared<bool>(true); // For TimerHandles; dropped first on destruction.
+        std::unordered_map<std::string, double> m_connect_rtt;
+        std::vector<std::string> m_connect_rtt_order; // Keys as they were added, as a ring once full.
+        std::size_t m_connect_rtt_next = 0; // Oldest in the ring.
+        std::atomic<bool> m_wake_pending = false;
+        std::array<evutil_socket_t, 2> m_wake_fd = {-1, -1};
+        std::unique_ptr<struct event, std::function<void(struct event *)>> m_wake_event;
+        std::thread::id m_thread = std::this_thread::get_id();
+        std::atomic<bool> m_shutdown = false;
     };
 }
 
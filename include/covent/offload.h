@@ -0,0 +1,125 @@
+//
+// Created by dwd on 10/17/26.
+//
+
+#ifndef COVENT_OFFLOAD_H
+#define COVENT_OFFLOAD_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <covent/coroutine.h>
+#include <covent/loop.h>
+#include <covent/temp.h>
+
+namespace covent {
+    /**
+     * Thread pool for CPU-heavy work that would otherwise stall a Loop.
+     *
+     * Each worker has its own deque: work submitted from a worker goes onto its own deque and is
+     * taken back LIFO, while work from anywhere else is spread round-robin. Idle workers steal
+     * from the other end of their neighbours' deques before going to sleep.
+     *
+     * Normally used via co_await covent::offload(fn).
+     */
+    class OffloadPool {
+    public:
+        struct WorkerMetrics {
+            std::uint64_t executed = 0;
+            std::uint64_t stolen = 0; // Of those executed, how many came from another worker's deque.
+            std::size_t queued = 0;
+        };
+        struct Metrics {
+            std::uint64_t submitted = 0;
+            std::vector<WorkerMetrics> workers;
+        };
+
+        explicit OffloadPool(std::size_t threads);
+        OffloadPool(OffloadPool const &) = delete;
+        OffloadPool(OffloadPool &&) = delete;
+        ~OffloadPool(); // Runs anything still queued, then joins.
+
+        static OffloadPool & pool(); // Shared default, sized to leave a core for the loop.
+
+        void submit(std::function<void()> && fn); // Any thread. fn must not throw.
+        [[nodiscard]] std::size_t size() const {
+            return m_workers.size();
+        }
+        [[nodiscard]] Metrics metrics() const;
+
+    private:
+        struct Worker {
+            mutable std::mutex mutex;
+            std::deque<std::function<void()>> queue;
+            std::atomic<std::uint64_t> executed = 0;
+            std::atomic<std::uint64_t> stolen = 0;
+        };
+        void run(std::size_t index);
+        bool take(std::size_t index, std::function<void()> & fn);
+
+        std::vector<std::unique_ptr<Worker>> m_workers;
+        std::vector<std::jthread> m_threads;
+        std::atomic<std::size_t> m_next = 0;
+        std::atomic<std::uint64_t> m_submitted = 0;
+        std::atomic<std::size_t> m_pending = 0;
+        std::mutex m_sleep_mutex;
+        std::condition_variable m_sleep;
+        bool m_stop = false;
+    };
+
+    // Usage: auto result = co_await covent::offload([&]() { return expensive(); });
+    // The callable runs on the pool; the task then resumes back on its own Loop.
+    // Anything the callable references must stay valid, and it mustn't touch the Loop.
+    template<typename F, typename R = std::invoke_result_t<F>>
+    struct offload {
+        static constexpr bool no_loop_resume = true;
+        struct State {
+            temp<R> result;
+            std::exception_ptr eptr;
+        };
+        mutable F m_fn;
+        OffloadPool & m_pool;
+        std::shared_ptr<State> m_state = std::make_shared<State>();
+
+        explicit offload(F fn, OffloadPool & pool = OffloadPool::pool()) : m_fn(std::move(fn)), m_pool(pool) {}
+
+        static bool await_ready() { return false; }
+        template<typename A, typename L>
+        void await_suspend(std::coroutine_handle<detail::wrapped_promise<A,L>> h) const {
+            auto * loop = h.promise().loop;
+            m_pool.submit([fn = std::move(m_fn), state = m_state, loop, h, ref = task_ref(h)]() mutable {
+                try {
+                    if constexpr (std::is_void_v<R>) {
+                        fn();
+                        state->result.assign();
+                    } else {
+                        state->result.assign(fn());
+                    }
+                } catch (...) {
+                    state->eptr = std::current_exception();
+                }
+                loop->post([h, ref]() {
+                    if (ref.alive()) {
+                        h.promise().resume_handle(h).resume();
+                    }
+                });
+            });
+        }
+        R await_resume() const {
+            if (m_state->eptr) std::rethrow_exception(m_state->eptr);
+            return m_state->result.value();
+        }
+        auto & operator co_await() const {
+            return *this;
+        }
+    };
+}
+
+#endif //COVENT_OFFLOAD_H
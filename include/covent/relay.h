@@ -0,0 +1,103 @@
+//
+// Created by dwd on 10/17/26.
+//
+
+#ifndef COVENT_RELAY_H
+#define COVENT_RELAY_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <covent/core.h>
+#include <covent/coroutine.h>
+#include <covent/future.h>
+#include <covent/loop.h>
+
+struct event;
+struct evbuffer;
+struct evbuffer_cb_entry;
+struct evbuffer_cb_info;
+
+namespace covent {
+    struct RelayOptions {
+        // Most octets held in flight each way: the pipe's size when splicing, or how much may be queued
+        // on the receiving session's output otherwise. Reading stops while it's full.
+        std::size_t buffer = 256 << 10;
+        bool splice = true; // Use splice(2) when neither side has TLS, where there is such a thing.
+    };
+
+    struct RelayStats {
+        std::uint64_t a_to_b = 0; // Octets.
+        std::uint64_t b_to_a = 0;
+        bool spliced = false;
+        bool aborted = false; // Ended by an error, or one side being closed, rather than both finishing.
+    };
+
+    /**
+     * Shuttle octets both ways between two connected sessions on the same Loop, until both directions have ended.
+     * When one side finishes sending, the other's write side is shut down - close_notify for TLS - once everything
+     * before it has been passed on, so half-closed connections carry on working the other way.
+     *
+     * Between plain sockets, data moves through a pipe with splice(2) and never reaches user space; otherwise
+     * the decrypted buffers are moved across whole, without copying. Anything already read is forwarded first.
+     *
+     * Neither session may have a reader, a process() call in progress or anything waiting on it. Both are closed
+     * once the relay is done.
+     */
+    task<RelayStats> relay(Session & a, Session & b, RelayOptions options = {});
+
+    namespace detail {
+        // The machinery behind relay(). While it runs, both sessions hand it their callbacks.
+        class Relay {
+        public:
+            Relay(Session & a, Session & b, RelayOptions const & options);
+            Relay(Relay const &) = delete;
+            ~Relay();
+
+            future<RelayStats> & run();
+
+            void readable(Session & session);
+            void drained(Session & session);
+            void ended(Session & session, short flags);
+            void detached(Session & session); // It's being closed under us.
+
+        private:
+            struct Direction {
+                Relay * relay;
+                Session * from;
+                Session * to;
+                std::uint64_t * count;
+                bool eof = false; // From's done sending.
+                bool shut = false; // And that's been passed on.
+                int pipe[2] = {-1, -1};
+                std::size_t pending = 0; // Octets sitting in the pipe.
+                struct event * read_event = nullptr; // On from's socket.
+                struct event * write_event = nullptr; // On to's.
+                struct evbuffer * lower = nullptr; // Under to's TLS, while waiting for its close_notify to go.
+                struct evbuffer_cb_entry * flushing = nullptr;
+            };
+            static void splice_cb(evutil_socket_t, short, void * arg);
+            static void flushed_cb(struct evbuffer *, struct evbuffer_cb_info const *, void * arg);
+            void pump(Direction & d);
+            void pump_buffers(Direction & d);
+            void pump_splice(Direction & d);
+            void half_close(Direction & d);
+            void finish(bool aborted);
+            void stop();
+            void resolve();
+            Direction & from(Session & session);
+            Direction & to(Session & session);
+
+            Loop & m_loop;
+            RelayOptions m_options;
+            RelayStats m_stats;
+            std::size_t m_capacity = 0; // Of each pipe.
+            std::array<Direction, 2> m_directions;
+            bool m_finished = false;
+            TimerHandle m_resolve;
+            future<RelayStats> m_done;
+        };
+    }
+}
+
+#endif //COVENT_RELAY_H
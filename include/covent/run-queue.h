@@ -0,0 +1,42 @@
+//
+// Created by dwd on 10/17/26.
+//
+
+#ifndef COVENT_RUN_QUEUE_H
+#define COVENT_RUN_QUEUE_H
+
+#include <atomic>
+#include <functional>
+
+namespace covent::detail {
+    /**
+     * Multi-producer, single-consumer queue of calls to make on a Loop's thread.
+     *
+     * This is Vyukov's intrusive MPSC queue: pushing is a single atomic exchange plus a store, and
+     * never blocks; popping is only ever done by the owning Loop. A push can briefly be invisible to
+     * the consumer while the producer is between those two steps, so pop() can report empty even
+     * though push() has begun - the Loop's wakeup protocol copes with that.
+     */
+    class RunQueue {
+    public:
+        RunQueue();
+        RunQueue(RunQueue const &) = delete;
+        RunQueue(RunQueue &&) = delete;
+        ~RunQueue();
+
+        void push(std::function<void()> && fn); // Any thread.
+        bool pop(std::function<void()> & fn); // Loop thread only.
+        [[nodiscard]] bool empty() const; // Loop thread only.
+
+    private:
+        struct Node {
+            std::atomic<Node *> next = nullptr;
+            std::function<void()> fn;
+        };
+        std::atomic<Node *> m_head; // Producers push here.
+        Node * m_tail; // Consumer pops from here.
+        Node m_stub;
+    };
+}
+
+#endif //COVENT_RUN_QUEUE_H
@@ -13,6 +13,13 @@ namespace covent::sentry {
     class span;
     class transaction;
 
+    // Span tracking follows each task tree through its coroutines. It can be compiled out entirely
+    // (COVENT_SPAN_TRACKING=OFF); otherwise, each new root task is tracked always, never, or one in
+    // every sample_every. Untracked tasks cost a branch per resume, and span::start() in them returns null.
+    enum class tracking { off, sampled, on };
+    void set_tracking(tracking mode, unsigned sample_every = 64);
+    tracking get_tracking();
+
     class span : public std::enable_shared_from_this<span> {
         sentry_span_t *  m_span = nullptr;
         std::shared_ptr<transaction> m_trans;
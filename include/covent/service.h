@@ -85,6 +85,8 @@ namespace covent {
             [[nodiscard]] generator_async<dns::rr::SRV> srv_lookup(std::string domain, std::vector<std::string> services, bool dnssec_only = false) const;
 
             generator_async<ConnectInfo> xmpp_lookup(std::string domain) const;
+            // Connect the session to the first reachable xmpp_lookup() target, racing each target's addresses.
+            [[nodiscard]] task<std::optional<ConnectInfo>> xmpp_connect(Session & session, std::string domain, ConnectPolicy policy = {}) const;
 
             [[nodiscard]] task<void> discover_tlsa(dns::Resolver &, GatheredData &, std::string, uint16_t) const;
         };
@@ -13,34 +13,36 @@ namespace covent {
     struct sleep {
         static constexpr bool no_loop_resume = true;
         Time m_time;
+        mutable TimerHandle m_timer;
 
         explicit sleep(Time t) : m_time(t) {}
+        sleep(sleep const & other) : m_time(other.m_time) {}
+        // If the awaiting coroutine is destroyed while suspended, we go with it - so take the timer too.
+        ~sleep() {
+            m_timer.cancel();
+        }
 
         static bool await_ready() { return false; }
         static void await_resume() {}
         template<typename A, typename L>
         void await_suspend(std::coroutine_handle<detail::wrapped_promise<A,L>> p) const {
-            std::weak_ptr<bool> liveness = p.promise().liveness;
-            p.promise().loop->defer([p, liveness]() {
-                auto alive = liveness.lock();
-                if (alive) {
+            m_timer = p.promise().loop->defer([p, ref = task_ref(p)]() {
+                if (ref.alive()) {
                     p.resume();
                 }
             }, m_time);
         }
         template<typename A>
         void await_suspend(std::coroutine_handle<detail::promise<A>> p) const {
-            std::weak_ptr<bool> liveness = p.promise().liveness;
-            p.promise().loop->defer([p, liveness]() {
-                auto alive = liveness.lock();
-                if (alive) {
+            m_timer = p.promise().loop->defer([p, ref = task_ref(p)]() {
+                if (ref.alive()) {
                     p.resume();
                 }
             }, m_time);
         }
         void await_suspend(std::coroutine_handle<> p) const {
             // Also here?
-            covent::Loop::thread_loop().defer([p]() {
+            m_timer = covent::Loop::thread_loop().defer([p]() {
                 p.resume();
             }, m_time);
         }
@@ -0,0 +1,133 @@
+//
+// Created by dwd on 10/17/26.
+//
+
+#ifndef COVENT_SLOT_MAP_H
+#define COVENT_SLOT_MAP_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace covent::detail {
+    /**
+     * Generational slot map, used by the Loop to hold its Sessions.
+     *
+     * An id is reserved first, and a value attached to it later (or never); lookup, attach, detach
+     * and release are all O(1), and slots are recycled through a free list so steady-state
+     * operation doesn't allocate. Ids carry a generation, so a stale id finds nothing rather than
+     * whatever has since reused its slot. T is expected to be pointer-like - a default-constructed
+     * T means "nothing attached".
+     *
+     * Not thread-safe; belongs to a single Loop.
+     */
+    template<typename T>
+    class SlotMap {
+    public:
+        using id_type = std::uint64_t; // Generation in the top half, slot index in the bottom.
+
+        id_type reserve() {
+            std::uint32_t index;
+            if (m_free != npos) {
+                index = m_free;
+                m_free = m_slots[index].next;
+            } else {
+                index = static_cast<std::uint32_t>(m_slots.size());
+                m_slots.emplace_back().generation = 1;
+            }
+            auto & slot = m_slots[index];
+            slot.reserved = true;
+            return (static_cast<id_type>(slot.generation) << 32) | index;
+        }
+        // Drop the reservation; the id (and any value still attached) are gone for good.
+        void release(id_type id) {
+            auto * slot = lookup(id);
+            if (!slot) return;
+            // Destroying the value might well release this id again, so only do that once we're consistent.
+            auto old = std::exchange(slot->value, T{});
+            if (old) --m_size;
+            slot->reserved = false;
+            if (++slot->generation == 0) slot->generation = 1; // Zero is never a valid id.
+            slot->next = m_free;
+            m_free = static_cast<std::uint32_t>(id & 0xFFFFFFFF);
+        }
+
+        bool attach(id_type id, T value) {
+            auto * slot = lookup(id);
+            if (!slot || !value) return false;
+            if (!slot->value) ++m_size;
+            slot->value = std::move(value);
+            return true;
+        }
+        // Remove the value, but keep the id reserved. (As with release, the value is destroyed last.)
+        bool detach(id_type id) {
+            auto * slot = lookup(id);
+            if (!slot || !slot->value) return false;
+            auto old = std::exchange(slot->value, T{});
+            --m_size;
+            return true;
+        }
+
+        [[nodiscard]] T const * find(id_type id) const noexcept {
+            auto const * slot = lookup(id);
+            if (!slot || !slot->value) return nullptr;
+            return &slot->value;
+        }
+        [[nodiscard]] bool contains(id_type id) const noexcept {
+            return find(id) != nullptr;
+        }
+
+        // Move every attached value out, leaving the ids reserved.
+        void drain(std::vector<T> & out) {
+            for (auto & slot : m_slots) {
+                if (slot.value) out.emplace_back(std::move(slot.value));
+                slot.value = T{};
+            }
+            m_size = 0;
+        }
+
+        // Visit every attached value, with its id.
+        template<typename F>
+        void for_each(F && fn) const {
+            for (std::uint32_t index = 0; index != m_slots.size(); ++index) {
+                auto const & slot = m_slots[index];
+                if (slot.value) fn((static_cast<id_type>(slot.generation) << 32) | index, slot.value);
+            }
+        }
+
+        [[nodiscard]] bool empty() const {
+            return m_size == 0;
+        }
+        [[nodiscard]] std::size_t size() const {
+            return m_size;
+        }
+
+    private:
+        static constexpr std::uint32_t npos = ~std::uint32_t{0};
+
+        struct Slot {
+            T value = {};
+            std::uint32_t generation = 0;
+            std::uint32_t next = npos;
+            bool reserved = false;
+        };
+
+        Slot const * lookup(id_type id) const noexcept {
+            auto index = static_cast<std::uint32_t>(id & 0xFFFFFFFF);
+            auto generation = static_cast<std::uint32_t>(id >> 32);
+            if (index >= m_slots.size()) return nullptr;
+            auto const & slot = m_slots[index];
+            if (!slot.reserved || slot.generation != generation) return nullptr;
+            return &slot;
+        }
+        Slot * lookup(id_type id) noexcept {
+            return const_cast<Slot *>(std::as_const(*this).lookup(id));
+        }
+
+        std::vector<Slot> m_slots;
+        std::uint32_t m_free = npos;
+        std::size_t m_size = 0;
+    };
+}
+
+#endif //COVENT_SLOT_MAP_H
@@ -6,9 +6,17 @@
 #define COVENT_SOCKADDR_CAST_H
 
 #include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <arpa/inet.h>
+#include <algorithm>
+#include <string>
 #include <type_traits>
 #include <exception>
+#include <stdexcept>
+#include <string_view>
+#include <cstddef>
 #include <cstring>
 
 namespace covent {
@@ -38,6 +46,12 @@ namespace covent {
             using type = constlike_t<T, base_type>;
         };
 
+        template<typename T>
+        struct sockaddr_family<T, AF_UNIX> {
+            using base_type = struct sockaddr_un;
+            using type = constlike_t<T, base_type>;
+        };
+
         template<typename A, typename B, typename C, typename D, typename R>
         D fourth_param(R (*)(A, B, C, D)) {
             return D{};
@@ -81,6 +95,12 @@ namespace covent {
             }
             throw unknown_address_family();
         }
+        if (sa_base->sa_family == AF_UNIX) {
+            // Abstract names (leading NUL) are shown with a leading '@' instead, as ss and friends do.
+            auto * const sun = sockaddr_cast<AF_UNIX>(sa);
+            if (sun->sun_path[0] == '\0') return "@" + std::string(sun->sun_path + 1, ::strnlen(sun->sun_path + 1, sizeof(sun->sun_path) - 1));
+            return {sun->sun_path, ::strnlen(sun->sun_path, sizeof(sun->sun_path))};
+        }
         throw unknown_address_family(EAFNOSUPPORT);
     }
 
@@ -94,8 +114,64 @@ namespace covent {
         if (sa_base->sa_family == AF_INET6) {
             return ntohs(sockaddr_cast<AF_INET6>(sa)->sin6_port);
         }
+        if (sa_base->sa_family == AF_UNIX) {
+            return 0;
+        }
         throw unknown_address_family(EAFNOSUPPORT);
     }
+
+    // The length to hand bind() or connect(). For AF_UNIX it has to be exact, since an abstract name is
+    // every octet up to the length given - so this assumes the rest of sun_path is zeroed, as unix_sockaddr() leaves it.
+    template<typename SA>
+    socklen_t sockaddr_len(SA * sa) {
+        auto * const sa_base = sockaddr_cast<AF_UNSPEC>(sa);
+        if (sa_base->sa_family == AF_INET) return sizeof(struct sockaddr_in);
+        if (sa_base->sa_family == AF_INET6) return sizeof(struct sockaddr_in6);
+        if (sa_base->sa_family == AF_UNIX) {
+            auto * const sun = sockaddr_cast<AF_UNIX>(sa);
+            auto const abstract = sun->sun_path[0] == '\0';
+            auto const len = abstract ? 1 + ::strnlen(sun->sun_path + 1, sizeof(sun->sun_path) - 1) : ::strnlen(sun->sun_path, sizeof(sun->sun_path)) + 1;
+            return static_cast<socklen_t>(offsetof(struct sockaddr_un, sun_path) + std::min(len, sizeof(sun->sun_path)));
+        }
+        throw unknown_address_family(EAFNOSUPPORT);
+    }
+
+    // A filesystem path, or with a leading '@', a name in Linux's abstract namespace.
+    inline struct sockaddr_storage unix_sockaddr(std::string_view path) {
+        struct sockaddr_storage ss = {};
+        auto * sun = sockaddr_cast<AF_UNIX>(&ss);
+        sun->sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(sun->sun_path)) throw std::length_error("Unix socket path must be 1 to 107 octets");
+        std::memcpy(sun->sun_path, path.data(), path.size());
+        if (path.front() == '@') sun->sun_path[0] = '\0';
+        return ss;
+    }
+
+    // An IPv6 or IPv4 literal with a port, or a Unix socket as for unix_sockaddr() if it starts with '/' or '@'.
+    inline struct sockaddr_storage parse_sockaddr(std::string const & address, unsigned short port) {
+        if (!address.empty() && (address.front() == '/' || address.front() == '@')) return unix_sockaddr(address);
+        struct sockaddr_storage ss = {};
+        if (auto * sin6 = sockaddr_cast<AF_INET6>(&ss); 1 == inet_pton(AF_INET6, address.c_str(), &sin6->sin6_addr)) {
+            sin6->sin6_family = AF_INET6;
+            sin6->sin6_port = htons(port);
+        } else if (auto * sin = sockaddr_cast<AF_INET>(&ss); 1 == inet_pton(AF_INET, address.c_str(), &sin->sin_addr)) {
+            sin->sin_family = AF_INET;
+            sin->sin_port = htons(port);
+        } else {
+            throw std::runtime_error("Couldn't understand address syntax " + address);
+        }
+        return ss;
+    }
+
+    // Remove a Unix socket's file - but only a socket, never anything else that's at the path now. Abstract
+    // names, and other families, have nothing to remove.
+    inline void unlink_socket(struct sockaddr_storage const & ss) {
+        if (ss.ss_family != AF_UNIX) return;
+        auto const * path = sockaddr_cast<AF_UNIX>(&ss)->sun_path;
+        if (path[0] == '\0') return; // Abstract; the kernel drops it with the last socket.
+        struct stat st = {};
+        if (::lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) ::unlink(path);
+    }
 }
 
 #endif //COVENT_SOCKADDR_CAST_H
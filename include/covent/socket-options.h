@@ -0,0 +1,40 @@
+//
+// Created by dwd on 10/17/26.
+//
+
+#ifndef COVENT_SOCKET_OPTIONS_H
+#define COVENT_SOCKET_OPTIONS_H
+
+#include <optional>
+#include <event2/util.h>
+
+namespace covent {
+    /**
+     * Socket tuning, for Session::connect and ListenerBase. Anything left unset is left alone.
+     *
+     * A listener applies these to its listening socket before it listens, and accepted connections
+     * inherit them from there - which is also the only way receive buffer sizes can affect the window
+     * scale offered in the handshake. The listener-only options are ignored when connecting.
+     */
+    struct SocketOptions {
+        std::optional<bool> nodelay; // TCP_NODELAY
+        std::optional<int> receive_buffer; // SO_RCVBUF, in octets.
+        std::optional<int> send_buffer; // SO_SNDBUF, in octets.
+        std::optional<bool> keepalive; // SO_KEEPALIVE; switched on by any of the timers below.
+        std::optional<int> keepalive_idle; // TCP_KEEPIDLE, in seconds.
+        std::optional<int> keepalive_interval; // TCP_KEEPINTVL, in seconds.
+        std::optional<int> keepalive_count; // TCP_KEEPCNT
+        std::optional<int> user_timeout; // TCP_USER_TIMEOUT, in milliseconds.
+        std::optional<int> busy_poll; // SO_BUSY_POLL, in microseconds.
+        std::optional<int> tos; // IP_TOS, or IPV6_TCLASS for IPv6 sockets.
+        // Listening with TCP_FASTOPEN sets the queue length; connecting with it, any value uses TCP_FASTOPEN_CONNECT.
+        std::optional<int> fastopen;
+        std::optional<int> defer_accept; // TCP_DEFER_ACCEPT, in seconds. Listener only.
+        int backlog = -1; // Listener only. Negative lets the system choose.
+    };
+
+    // Throws covent_runtime_error naming the option that failed, or that isn't available here.
+    void apply(evutil_socket_t sock, SocketOptions const & options, bool listening);
+}
+
+#endif //COVENT_SOCKET_OPTIONS_H
@@ -0,0 +1,95 @@
+//
+// Created by dwd on 10/17/26.
+//
+
+#ifndef COVENT_TIMER_WHEEL_H
+#define COVENT_TIMER_WHEEL_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+namespace covent::detail {
+    /**
+     * Hierarchical timer wheel, used by the Loop to hold deferred calls and sleeps.
+     *
+     * Time is counted in millisecond ticks since construction. Each level has 64 slots, each slot
+     * covering 64x the span of a slot in the level below; timers are placed by their distance from
+     * the current tick and cascaded downward as the wheel turns. Insert and cancel are O(1), and
+     * entries live in a slab so steady-state operation doesn't allocate (beyond whatever the
+     * std::function itself needs).
+     *
+     * Not thread-safe; the Loop serialises access.
+     */
+    class TimerWheel {
+    public:
+        using clock = std::chrono::steady_clock;
+        using id_type = std::uint64_t; // Generation in the top half, slab index in the bottom.
+
+        static constexpr unsigned slot_bits = 6;
+        static constexpr unsigned slots = 1u << slot_bits;
+        static constexpr unsigned levels = 6;
+
+        explicit TimerWheel(clock::time_point origin = clock::now());
+
+        // Add a timer to fire no earlier than now + delay.
+        id_type add(std::function<void()> && fn, clock::duration delay, clock::time_point now = clock::now());
+        // Remove a pending timer. Returns false if it has already fired, or was already cancelled.
+        bool cancel(id_type id);
+        // Move a pending timer to fire no earlier than now + delay, keeping its id.
+        bool reschedule(id_type id, clock::duration delay, clock::time_point now = clock::now());
+        [[nodiscard]] bool pending(id_type id) const;
+
+        // Move every callback which is due at "now" onto the end of "out", in expiry order.
+        void expire(std::vector<std::function<void()>> & out, clock::time_point now = clock::now());
+        // Time until the wheel next needs turning; nullopt if empty, zero if something is due.
+        [[nodiscard]] std::optional<clock::duration> next_expiry(clock::time_point now = clock::now()) const;
+
+        [[nodiscard]] bool empty() const {
+            return m_size == 0;
+        }
+        [[nodiscard]] std::size_t size() const {
+            return m_size;
+        }
+
+    private:
+        static constexpr std::uint32_t npos = ~std::uint32_t{0};
+        static constexpr std::uint16_t due_list = levels * slots;
+        static constexpr std::uint16_t free_list = due_list + 1;
+
+        struct Entry {
+            std::function<void()> fn;
+            std::uint64_t expiry = 0;
+            std::uint32_t prev = npos;
+            std::uint32_t next = npos;
+            std::uint32_t generation = 0;
+            std::uint16_t list = free_list;
+        };
+        struct List {
+            std::uint32_t head = npos;
+            std::uint32_t tail = npos;
+        };
+
+        [[nodiscard]] std::uint64_t tick_at(clock::time_point t, bool round_up) const;
+        [[nodiscard]] std::optional<std::uint64_t> next_tick() const;
+        void place(std::uint32_t index);
+        void link(std::uint16_t list, std::uint32_t index);
+        void unlink(std::uint32_t index);
+        void cascade(unsigned level, unsigned slot);
+        void release(std::uint32_t index);
+
+        clock::time_point m_origin;
+        std::uint64_t m_now = 0;
+        std::size_t m_size = 0;
+        std::vector<Entry> m_entries;
+        std::uint32_t m_free = npos;
+        std::array<std::uint64_t, levels> m_occupied = {};
+        std::array<List, levels * slots> m_slots = {};
+        List m_due;
+    };
+}
+
+#endif //COVENT_TIMER_WHEEL_H
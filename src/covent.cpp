@@ -6,8 +6,14 @@
 #include <event2/event.h>
 #include <event2/thread.h>
 #include <event2/listener.h>
-#include <list>
 #include <covent/service.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
 
 namespace {
     thread_local covent::Loop * s_thread_loop = nullptr;
@@ -19,6 +25,18 @@ covent::Loop::Loop() {
     m_event_base = std::unique_ptr<struct event_base, std::function<void(struct event_base *)>>(event_base_new(), [](struct event_base * b){
         if (b) event_base_free(b);
     });
+#ifdef __linux__
+    m_wake_fd[0] = m_wake_fd[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_wake_fd[0] < 0) throw covent_runtime_error(std::strerror(errno));
+#else
+    if (evutil_socketpair(AF_UNIX, SOCK_STREAM, 0, m_wake_fd.data()) < 0) throw covent_runtime_error(std::strerror(errno));
+    evutil_make_socket_nonblocking(m_wake_fd[0]);
+    evutil_make_socket_nonblocking(m_wake_fd[1]);
+#endif
+    m_wake_event = std::unique_ptr<struct event, std::function<void(struct event *)>>(event_new(m_event_base.get(), m_wake_fd[0], EV_READ | EV_PERSIST, woken, this), [](struct event * e) {
+        if (e) event_free(e);
+    });
+    event_add(m_wake_event.get(), nullptr);
     if (!s_main_loop) s_main_loop = this;
     if (!s_thread_loop) s_thread_loop = this;
     m_http_service = std::make_unique<Service>();
@@ -46,28 +64,19 @@ covent::Loop &covent::Loop::main_loop() {
 
 void covent::Loop::run_once(bool block) {
     auto flags = EVLOOP_ONCE | EVLOOP_NO_EXIT_ON_EMPTY;
-    block = !set_next_break() && block;
+    block = !set_next_break() && block && m_run_queue.empty();
     if (!block) flags |= EVLOOP_NONBLOCK;
     if (m_shutdown) return;
     event_base_loop(m_event_base.get(), flags);
     if (m_shutdown) return;
     for (;;) {
-        std::list<std::function<void()>> run_now;
+        bool posted = run_posted();
+        std::vector<std::function<void()>> run_now;
         {
             std::scoped_lock<std::recursive_mutex> l_(m_scheduler_mutex);
-            struct timeval now;
-            gettimeofday(&now, nullptr);
-            while (!m_pending_actions.empty()) {
-                auto & next = m_pending_actions.begin()->first;
-                if (std::less<struct timeval>{}.operator()(next, now)) {
-                    run_now.emplace_back(std::move(m_pending_actions.begin()->second));
-                    m_pending_actions.erase(m_pending_actions.begin());
-                } else {
-                    break;
-                }
-            }
+            m_timers.expire(run_now);
         }
-        if (run_now.empty()) break;
+        if (run_now.empty() && !posted) break;
         for (auto const & fn : run_now) {
             fn();
         }
@@ -75,7 +84,7 @@ void covent::Loop::run_once(bool block) {
 }
 
 void covent::Loop::run_until_complete() {
-    run_until([this](){ return m_sessions.empty() && m_pending_actions.empty(); });
+    run_until([this](){ return m_sessions.empty() && m_timers.empty() && m_run_queue.empty(); });
 }
 
 void covent::Loop::run_until_complete(Session const & session) {
@@ -93,72 +102,152 @@ void covent::Loop::run() {
 
 void covent::Loop::shutdown() {
     m_shutdown = true;
+    if (!on_loop_thread()) {
+        wake();
+        return;
+    }
     struct timeval tv{0,0};
     event_base_loopexit(m_event_base.get(), &tv);
 }
 
 covent::Loop::~Loop() {
+    m_alive.reset();
+    {
+        // Sessions give their ids back as they go, so take them out of the map before they're destroyed.
+        std::vector<std::shared_ptr<Session>> sessions;
+        m_sessions.drain(sessions);
+    }
     if (s_main_loop == this) s_main_loop = nullptr;
     if (s_thread_loop == this) s_thread_loop = nullptr;
+    m_wake_event.reset();
+    evutil_closesocket(m_wake_fd[0]);
+    if (m_wake_fd[1] != m_wake_fd[0]) evutil_closesocket(m_wake_fd[1]);
+}
+
+void covent::Loop::post(std::function<void()> && fn) {
+    m_run_queue.push(std::move(fn));
+    // On our own thread, run_once will notice the queue before it blocks.
+    if (!on_loop_thread()) wake();
+}
+
+void covent::Loop::wake() {
+    // Only the first producer since the loop last looked pays for the syscall. The fence pairs with the one in
+    // run_posted: either the loop sees what was just pushed, or we see it's cleared the flag and write.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_wake_pending.load(std::memory_order_relaxed) || m_wake_pending.exchange(true)) return;
+#ifdef __linux__
+    std::uint64_t one = 1;
+    [[maybe_unused]] auto r = ::write(m_wake_fd[1], &one, sizeof(one));
+#else
+    char one = 1;
+    [[maybe_unused]] auto r = ::send(m_wake_fd[1], &one, 1, 0);
+#endif
+}
+
+void covent::Loop::woken(evutil_socket_t fd, short, void *) {
+    // Just drain the descriptor; run_once does the actual work once libevent returns.
+    std::array<char, 64> buf; // NOSONAR
+    while (::read(fd, buf.data(), buf.size()) > 0) {
+        // Eat it all.
+    }
+}
+
+bool covent::Loop::run_posted() {
+    // Clear this before looking at the queue, so anything we miss will wake us again.
+    m_wake_pending = false;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    bool ran = false;
+    std::function<void()> fn;
+    while (m_run_queue.pop(fn)) {
+        fn();
+        ran = true;
+    }
+    return ran;
 }
 
 
 bool covent::Loop::set_next_break() {
-    struct timeval now;
-    gettimeofday(&now, nullptr);
-    if (m_pending_actions.empty()) return false;
-    struct timeval t = m_pending_actions.begin()->first;
-    if (t.tv_usec <= now.tv_usec) {
-        if (t.tv_sec <= now.tv_sec) {
-            event_base_loopbreak(m_event_base.get());
-            return true;
-        }
-        t.tv_sec -= 1;
-        t.tv_usec += 1000000;
+    std::optional<detail::TimerWheel::clock::duration> next;
+    {
+        std::scoped_lock<std::recursive_mutex> l_(m_scheduler_mutex);
+        next = m_timers.next_expiry();
     }
-    if (t.tv_sec < now.tv_sec) {
+    if (!next) return false;
+    if (*next <= detail::TimerWheel::clock::duration::zero()) {
         event_base_loopbreak(m_event_base.get());
         return true;
     }
-    t.tv_sec -= now.tv_sec;
-    t.tv_usec -= now.tv_usec;
+    auto usec = std::chrono::ceil<std::chrono::microseconds>(*next).count();
+    struct timeval t{
+        .tv_sec = static_cast<time_t>(usec / 1000000),
+        .tv_usec = static_cast<suseconds_t>(usec % 1000000)
+    };
     event_base_loopexit(m_event_base.get(), &t);
     return false;
 }
 
-void covent::Loop::defer(std::function<void()> &&fn, struct timeval seconds) {
+covent::TimerHandle covent::Loop::defer(std::function<void()> &&fn, struct timeval seconds) {
     std::scoped_lock<std::recursive_mutex> l_(m_scheduler_mutex);
-    struct timeval now;
-    gettimeofday(&now, nullptr);
-    struct timeval when = now;
-    when.tv_sec += seconds.tv_sec;
-    when.tv_usec += seconds.tv_usec;
-    if (when.tv_usec >= 1000000) {
-        when.tv_sec += 1;
-        when.tv_usec -= 1000000;
-    }
-    m_pending_actions.emplace(when, std::move(fn));
-    if (seconds.tv_sec == 0 && seconds.tv_usec == 0) {
+    auto delay = std::chrono::seconds(seconds.tv_sec) + std::chrono::microseconds(seconds.tv_usec);
+    auto id = m_timers.add(std::move(fn), delay);
+    if (!on_loop_thread()) {
+        wake(); // Loop will recalculate its next break when it wakes up.
+    } else if (seconds.tv_sec == 0 && seconds.tv_usec == 0) {
         event_base_loopbreak(m_event_base.get());
     } else {
         set_next_break();
     }
+    return {*this, id};
 }
 
-void covent::Loop::defer(std::function<void()> &&fn, double seconds) {
-    struct timeval when{
+struct timeval covent::Loop::to_timeval(double seconds) {
+    return {
         .tv_sec = static_cast<time_t>(seconds),
         .tv_usec = static_cast<suseconds_t>(seconds * 1000000) % 1000000
     };
-    this->defer(std::move(fn), when);
 }
 
-void covent::Loop::defer(std::function<void()> &&fn, long seconds) {
-    this->defer(std::move(fn), {seconds, 0});
+covent::TimerHandle covent::Loop::defer(std::function<void()> &&fn, double seconds) {
+    return this->defer(std::move(fn), to_timeval(seconds));
 }
 
-void covent::Loop::defer(std::function<void()> &&fn) {
-    this->defer(std::move(fn), {0, 0});
+covent::TimerHandle covent::Loop::defer(std::function<void()> &&fn, long seconds) {
+    return this->defer(std::move(fn), {seconds, 0});
+}
+
+covent::TimerHandle covent::Loop::defer(std::function<void()> &&fn) {
+    return this->defer(std::move(fn), {0, 0});
+}
+
+covent::TimerHandle::TimerHandle(Loop & loop, detail::TimerWheel::id_type id) : m_loop(&loop), m_alive(loop.m_alive), m_id(id) {}
+
+bool covent::TimerHandle::cancel() {
+    if (!live()) return false;
+    std::scoped_lock<std::recursive_mutex> l_(m_loop->m_scheduler_mutex);
+    return m_loop->m_timers.cancel(m_id);
+}
+
+bool covent::TimerHandle::reschedule(struct timeval seconds) {
+    if (!live()) return false;
+    std::scoped_lock<std::recursive_mutex> l_(m_loop->m_scheduler_mutex);
+    auto delay = std::chrono::seconds(seconds.tv_sec) + std::chrono::microseconds(seconds.tv_usec);
+    if (!m_loop->m_timers.reschedule(m_id, delay)) return false;
+    if (m_loop->on_loop_thread()) {
+        m_loop->set_next_break();
+    } else {
+        m_loop->wake();
+    }
+    return true;
+}
+
+bool covent::TimerHandle::reschedule(double seconds) {
+    return reschedule(Loop::to_timeval(seconds));
+}
+
+bool covent::TimerHandle::pending() const {
+    if (!live()) return false;
+    std::scoped_lock<std::recursive_mutex> l_(m_loop->m_scheduler_mutex);
+    return m_loop->m_timers.pending(m_id);
 }
 
 void covent::Loop::listen(ListenerBase & listener) {
@@ -166,25 +255,190 @@ void covent::Loop::listen(ListenerBase & listener) {
 }
 
 std::shared_ptr<covent::Session> covent::Loop::add(std::shared_ptr<Session> const & optr) {
-    m_sessions.emplace(optr);
+    m_sessions.attach(optr->id(), optr);
     return optr;
 }
 
 std::shared_ptr<covent::Session> covent::Loop::session(Session::id_type id) const {
-    auto result = m_sessions.find(id);
-    if (result == m_sessions.end()) {
-        throw std::runtime_error("Session not found");
-    }
-    return *result;
+    if (auto const * found = m_sessions.find(id); found) return *found;
+    return {};
 }
 
 void covent::Loop::remove(const covent::Session &sess) {
-    auto ptr = session(sess.id());
-    remove(ptr);
+    if (sess.m_reap_at) reap_cancel(sess.id(), sess.m_reap_at);
+    m_sessions.detach(sess.id());
 }
 
 void covent::Loop::remove(std::shared_ptr<Session> const & sess) {
-    m_sessions.erase(sess);
+    remove(*sess);
+}
+
+void covent::Loop::memory_budget(std::size_t octets) {
+    m_memory_budget = octets;
+    m_shed_at = octets;
+    if (!octets || m_memory.buffered <= octets / 4 * 3) {
+        for (auto id : std::exchange(m_budget_paused, {})) {
+            if (auto const * s = m_sessions.find(id); s) (*s)->resume_reading(Session::pause_budget);
+        }
+        m_memory.paused = 0;
+    } else if (m_memory.buffered > octets) {
+        shed();
+    }
+}
+
+void covent::Loop::buffered(std::size_t added, std::size_t removed) {
+    m_memory.buffered = m_memory.buffered + added - removed;
+    if (!m_memory_budget) {
+        m_memory.peak = std::max(m_memory.peak, m_memory.buffered);
+        return;
+    }
+    if (added > removed) {
+        m_memory.peak = std::max(m_memory.peak, m_memory.buffered);
+        if (m_memory.buffered > m_shed_at) shed();
+    } else if (!m_budget_paused.empty() && m_memory.buffered <= m_memory_budget / 4 * 3) {
+        memory_budget(m_memory_budget);
+    }
+}
+
+// Pause the largest sessions still reading, until they hold enough that draining them would get us back
+// under the resume level. Doesn't look again until another eighth of the budget has come in.
+void covent::Loop::shed() {
+    std::vector<std::pair<std::size_t, Session::id_type>> candidates;
+    m_sessions.for_each([&candidates](Session::id_type id, std::shared_ptr<Session> const & s) {
+        if (!(s->m_read_paused & Session::pause_budget) && s->m_buffered) candidates.emplace_back(s->m_buffered, id);
+    });
+    std::ranges::sort(candidates, std::greater<>{});
+    auto const excess = m_memory.buffered - m_memory_budget / 4 * 3;
+    std::size_t held = 0;
+    for (auto const & [size, id] : candidates) {
+        if (held >= excess) break;
+        (*m_sessions.find(id))->pause_reading(Session::pause_budget);
+        m_budget_paused.push_back(id);
+        ++m_memory.pauses;
+        held += size;
+    }
+    m_memory.paused = m_budget_paused.size();
+    m_shed_at = m_memory.buffered + m_memory_budget / 8;
+}
+
+void covent::Loop::unpause(Session::id_type id) {
+    std::erase(m_budget_paused, id);
+    m_memory.paused = m_budget_paused.size();
+}
+
+std::uint64_t covent::Loop::reap_ticks(double seconds) const {
+    return std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(seconds / m_reap_resolution)));
+}
+
+std::uint64_t covent::Loop::reap_clock() const {
+    std::chrono::duration<double> const since = std::chrono::steady_clock::now() - m_reap_epoch;
+    return static_cast<std::uint64_t>(since.count() / m_reap_resolution);
+}
+
+void covent::Loop::reap_sync() {
+    // While the timer's running, it keeps the tick up to date; otherwise it's stood still since.
+    if (!m_reap_timer.pending()) m_reap_tick = std::max(m_reap_tick, reap_clock());
+}
+
+void covent::Loop::reap_arm() {
+    if (m_reap_timer.pending()) return;
+    // Aim for the start of the next tick, so a late firing doesn't push the rest back.
+    std::chrono::duration<double> const next{m_reap_resolution * static_cast<double>(m_reap_tick + 1)};
+    std::chrono::duration<double> const delay = next - (std::chrono::steady_clock::now() - m_reap_epoch);
+    m_reap_timer = defer([this]() { reap_tick(); }, std::max(delay.count(), 0.0));
+}
+
+void covent::Loop::reap_schedule(Session::id_type id, std::uint64_t tick) {
+    m_reap_slots[tick % m_reap_slots.size()].emplace_back(id, tick);
+    ++m_reap_pending;
+    reap_arm();
+}
+
+void covent::Loop::reap_cancel(Session::id_type id, std::uint64_t tick) {
+    // It may already be out of the wheel, if the reaper's working through its slot right now.
+    if (!std::erase(m_reap_slots[tick % m_reap_slots.size()], std::make_pair(id, tick))) return;
+    if (!--m_reap_pending) m_reap_timer.cancel();
+}
+
+void covent::Loop::reap_tick() {
+    auto const now = std::max(m_reap_tick, reap_clock());
+    // Every slot we've passed since last time, or the whole wheel if we've been away at least a turn.
+    auto const passed = std::min<std::uint64_t>(now - m_reap_tick, m_reap_slots.size());
+    m_reap_tick = now;
+    for (auto t = now - passed + 1; t <= now; ++t) {
+        auto due = std::exchange(m_reap_slots[t % m_reap_slots.size()], {});
+        for (auto const & [id, tick] : due) {
+            if (tick > now) {
+                m_reap_slots[t % m_reap_slots.size()].emplace_back(id, tick); // Next time round.
+                continue;
+            }
+            --m_reap_pending;
+            auto const * found = m_sessions.find(id);
+            if (!found) continue;
+            auto session = *found;
+            if (session->m_reap_at != tick) continue; // Superseded since.
+            session->reap_check(now);
+        }
+    }
+    if (m_reap_pending) reap_arm();
+}
+
+void covent::Loop::measure_lag(double interval) {
+    m_lag_interval = interval;
+    if (m_lag_timer.pending()) return;
+    auto expected = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(interval));
+    m_lag_timer = defer([this, expected]() { lag_sample(expected); }, interval);
+}
+
+void covent::Loop::lag_sample(std::chrono::steady_clock::time_point expected) {
+    auto now = std::chrono::steady_clock::now();
+    auto late = std::max(0.0, std::chrono::duration<double>(now - expected).count());
+    m_lag += (late - m_lag) / 4;
+    expected = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(m_lag_interval));
+    m_lag_timer = defer([this, expected]() { lag_sample(expected); }, m_lag_interval);
+}
+
+namespace {
+    std::string rtt_key(struct sockaddr const * addr) {
+        return covent::address_tostring(addr) + "#" + std::to_string(covent::address_toport(addr));
+    }
+}
+
+std::optional<double> covent::Loop::connect_rtt(struct sockaddr const * addr) const {
+    if (auto it = m_connect_rtt.find(rtt_key(addr)); it != m_connect_rtt.end()) return it->second;
+    return {};
+}
+
+void covent::Loop::connect_rtt(struct sockaddr const * addr, double seconds, bool floor) {
+    auto key = rtt_key(addr);
+    auto it = m_connect_rtt.find(key);
+    if (it == m_connect_rtt.end()) {
+        // Once full, each new address takes the place of the oldest.
+        constexpr std::size_t connect_rtt_max = 4096;
+        if (m_connect_rtt_order.size() < connect_rtt_max) {
+            m_connect_rtt_order.push_back(key);
+        } else {
+            auto & oldest = m_connect_rtt_order[m_connect_rtt_next];
+            m_connect_rtt.erase(oldest);
+            oldest = key;
+            m_connect_rtt_next = (m_connect_rtt_next + 1) % connect_rtt_max;
+        }
+        m_connect_rtt.emplace(std::move(key), seconds);
+        return;
+    }
+    if (floor) {
+        it->second = std::max(it->second, seconds);
+    } else {
+        it->second += (seconds - it->second) / 4;
+    }
+}
+
+covent::Session::id_type covent::Loop::reserve_session_id() {
+    return m_sessions.reserve();
+}
+
+void covent::Loop::release_session_id(Session::id_type id) {
+    m_sessions.release(id);
 }
 
 covent::task<void> covent::detail::dummy() {
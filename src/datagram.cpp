@@ -0,0 +1,394 @@
+//
+// Created by dwd on 10/17/26.
+//
+
+#include <covent/datagram.h>
+#include <covent/exceptions.h>
+#include <covent/loop.h>
+#include <covent/sockaddr-cast.h>
+#include <event2/event.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#ifndef __linux__
+namespace {
+    // No recvmmsg or sendmmsg here; do them one at a time.
+    struct mmsghdr {
+        struct msghdr msg_hdr;
+        unsigned int msg_len;
+    };
+
+    int recvmmsg(int fd, struct mmsghdr * msgs, unsigned int len, int flags, struct timespec *) {
+        unsigned int i = 0;
+        for (; i != len; ++i) {
+            auto n = ::recvmsg(fd, &msgs[i].msg_hdr, flags);
+            if (n < 0) return i ? static_cast<int>(i) : -1;
+            msgs[i].msg_len = static_cast<unsigned int>(n);
+        }
+        return static_cast<int>(i);
+    }
+
+    int sendmmsg(int fd, struct mmsghdr * msgs, unsigned int len, int flags) {
+        unsigned int i = 0;
+        for (; i != len; ++i) {
+            auto n = ::sendmsg(fd, &msgs[i].msg_hdr, flags);
+            if (n < 0) return i ? static_cast<int>(i) : -1;
+            msgs[i].msg_len = static_cast<unsigned int>(n);
+        }
+        return static_cast<int>(i);
+    }
+}
+#endif
+
+namespace {
+    constexpr std::size_t gro_slot_size = 65535;
+    constexpr std::size_t gso_max_segments = 64;
+    constexpr std::size_t gso_max_size = 65000;
+    // Until we know the path, segments have to fit a 1500 octet MTU once the IP and UDP headers are on.
+    constexpr std::size_t gso_segment_v4 = 1500 - 20 - 8;
+    constexpr std::size_t gso_segment_v6 = 1500 - 40 - 8;
+    constexpr std::size_t send_messages = 64; // Per sendmmsg call.
+    constexpr std::size_t send_iov = 1024;
+    constexpr std::size_t gro_control = CMSG_SPACE(sizeof(int));
+    constexpr std::size_t gso_control = CMSG_SPACE(sizeof(std::uint16_t));
+
+    bool would_block(int err) {
+        return err == EAGAIN || err == EWOULDBLOCK || err == EINTR;
+    }
+
+    bool same_peer(struct sockaddr const * a, struct sockaddr const * b) {
+        if (!a || !b) return a == b;
+        if (a->sa_family != b->sa_family) return false;
+        auto len = covent::sockaddr_len(a);
+        return len == covent::sockaddr_len(b) && std::memcmp(a, b, len) == 0;
+    }
+}
+
+// Everything one recvmmsg needs, allocated once and then passed between the pool and the batches it fills.
+struct covent::detail::DatagramBlock {
+    std::unique_ptr<char[]> data;
+    std::vector<struct sockaddr_storage> peers;
+    std::vector<struct mmsghdr> headers;
+    std::vector<struct iovec> iov;
+    std::vector<char> control;
+
+    DatagramBlock(std::size_t batch, std::size_t slot_size, bool gro)
+        : data(new char[batch * slot_size]), peers(batch), headers(batch), iov(batch), control(gro ? batch * gro_control : 0) {
+        for (std::size_t i = 0; i != batch; ++i) {
+            iov[i] = {data.get() + i * slot_size, slot_size};
+        }
+    }
+};
+
+struct covent::detail::DatagramPool {
+    std::size_t batch;
+    std::size_t slot_size;
+    bool gro;
+    std::vector<std::unique_ptr<DatagramBlock>> free;
+
+    std::unique_ptr<DatagramBlock> take() {
+        if (free.empty()) return std::make_unique<DatagramBlock>(batch, slot_size, gro);
+        auto block = std::move(free.back());
+        free.pop_back();
+        return block;
+    }
+    void give(std::unique_ptr<DatagramBlock> && block) {
+        if (free.size() < 4) free.push_back(std::move(block)); // Any more than that were only needed in a burst.
+    }
+};
+
+covent::DatagramBatch::DatagramBatch() = default;
+covent::DatagramBatch::DatagramBatch(DatagramBatch &&) noexcept = default;
+
+covent::DatagramBatch & covent::DatagramBatch::operator=(DatagramBatch && other) noexcept {
+    if (this != &other) {
+        if (m_pool && m_block) m_pool->give(std::move(m_block));
+        m_pool = std::move(other.m_pool);
+        m_block = std::move(other.m_block);
+        m_datagrams = std::move(other.m_datagrams);
+    }
+    return *this;
+}
+
+covent::DatagramBatch::~DatagramBatch() {
+    if (m_pool && m_block) m_pool->give(std::move(m_block));
+}
+
+// Waits for the socket to become readable or writable. Only ever one of each at a time.
+class covent::DatagramEndpoint::ready {
+public:
+    static constexpr bool no_loop_resume = true;
+
+    ready(DatagramEndpoint & endpoint, short what) : m_endpoint(&endpoint), m_what(what) {}
+    ready(ready const & other) : m_endpoint(other.m_endpoint), m_what(other.m_what) {}
+    // If the awaiting coroutine is destroyed while suspended, stop waiting on its behalf.
+    ~ready() {
+        if (m_endpoint && slot() == this) {
+            slot() = nullptr;
+            event_del(m_what == EV_READ ? m_endpoint->m_read_event : m_endpoint->m_write_event);
+        }
+    }
+
+    static bool await_ready() { return false; }
+    static void await_resume() {}
+    template<typename P>
+    void await_suspend(std::coroutine_handle<P> h) const {
+        auto *& waiter = slot();
+        if (waiter) throw covent_logic_error(m_what == EV_READ ? "Already waiting to receive" : "Already waiting to send");
+        m_handle = h;
+        m_ref = task_ref(h);
+        waiter = const_cast<ready *>(this);
+        event_add(m_what == EV_READ ? m_endpoint->m_read_event : m_endpoint->m_write_event, nullptr);
+    }
+    auto & operator co_await() const {
+        return *this;
+    }
+
+    void fire() const {
+        if (m_ref.alive()) m_handle.resume();
+    }
+    void orphan() const {
+        m_endpoint = nullptr;
+    }
+
+private:
+    ready *& slot() const {
+        return m_what == EV_READ ? m_endpoint->m_reader : m_endpoint->m_writer;
+    }
+
+    mutable DatagramEndpoint * m_endpoint;
+    short m_what;
+    mutable std::coroutine_handle<> m_handle;
+    mutable task_ref m_ref;
+};
+
+covent::DatagramEndpoint::DatagramEndpoint(Loop & loop, std::string const & address, unsigned short port, DatagramOptions options)
+    : m_loop(loop), m_options(std::move(options)), m_sockaddr(parse_sockaddr(address, port)) {
+    if (!m_options.batch) throw covent_logic_error("Datagram batch size must be at least one");
+    m_fd = ::socket(m_sockaddr.ss_family, SOCK_DGRAM, 0);
+    if (m_fd < 0) throw covent_runtime_error(std::strerror(errno));
+    evutil_make_socket_nonblocking(m_fd);
+    evutil_make_socket_closeonexec(m_fd);
+    try {
+        apply(m_fd, m_options.options, false);
+        unlink_socket(m_sockaddr); // As for a Listener, clear away a socket left by an earlier run.
+        if (::bind(m_fd, sockaddr(), sockaddr_len(&m_sockaddr)) != 0) {
+            throw covent_runtime_error(std::string("Couldn't bind datagram socket: ") + std::strerror(errno));
+        }
+    } catch (...) {
+        evutil_closesocket(m_fd);
+        throw;
+    }
+    if (m_sockaddr.ss_family != AF_UNIX) {
+        socklen_t len = sizeof(m_sockaddr);
+        ::getsockname(m_fd, sockaddr_cast<AF_UNSPEC>(&m_sockaddr), &len); // Find out which port we got.
+#ifdef UDP_GRO
+        int on = 1;
+        m_gro = m_options.gro && ::setsockopt(m_fd, SOL_UDP, UDP_GRO, &on, sizeof(on)) == 0;
+#endif
+#ifdef UDP_SEGMENT
+        int segment = 0;
+        socklen_t segment_len = sizeof(segment);
+        m_gso = m_options.gso && ::getsockopt(m_fd, SOL_UDP, UDP_SEGMENT, &segment, &segment_len) == 0;
+        m_gso_segment = m_sockaddr.ss_family == AF_INET6 ? gso_segment_v6 : gso_segment_v4;
+#endif
+    }
+    m_slot_size = m_gro ? gro_slot_size : m_options.max_size;
+    m_pool = std::make_shared<detail::DatagramPool>(detail::DatagramPool{m_options.batch, m_slot_size, m_gro});
+    m_read_event = event_new(m_loop.event_base(), m_fd, EV_READ, ready_cb, this);
+    m_write_event = event_new(m_loop.event_base(), m_fd, EV_WRITE, ready_cb, this);
+}
+
+covent::DatagramEndpoint::~DatagramEndpoint() {
+    if (m_reader) m_reader->orphan();
+    if (m_writer) m_writer->orphan();
+    event_free(m_read_event);
+    event_free(m_write_event);
+    evutil_closesocket(m_fd);
+    unlink_socket(m_sockaddr);
+}
+
+struct sockaddr const * covent::DatagramEndpoint::sockaddr() const {
+    return sockaddr_cast<AF_UNSPEC>(&m_sockaddr);
+}
+
+void covent::DatagramEndpoint::connect(struct sockaddr const * peer) {
+    if (::connect(m_fd, peer, sockaddr_len(peer)) != 0) throw covent_runtime_error(std::strerror(errno));
+    m_connected = true;
+#if defined(IP_MTU) && defined(IPV6_MTU)
+    if (m_gso) {
+        // Now there's a route, the kernel can say how big a segment it'll take.
+        int mtu = 0;
+        socklen_t mtu_len = sizeof(mtu);
+        bool v6 = m_sockaddr.ss_family == AF_INET6;
+        if (::getsockopt(m_fd, v6 ? IPPROTO_IPV6 : IPPROTO_IP, v6 ? IPV6_MTU : IP_MTU, &mtu, &mtu_len) == 0) {
+            auto headers = (v6 ? 40 : 20) + 8;
+            if (mtu > headers) m_gso_segment = static_cast<std::size_t>(mtu - headers);
+        }
+    }
+#endif
+}
+
+void covent::DatagramEndpoint::ready_cb(evutil_socket_t, short what, void * arg) {
+    auto & endpoint = *static_cast<DatagramEndpoint *>(arg);
+    auto * waiter = std::exchange(what & EV_READ ? endpoint.m_reader : endpoint.m_writer, nullptr);
+    if (waiter) waiter->fire();
+}
+
+covent::DatagramBatch covent::DatagramEndpoint::try_recv() {
+    DatagramBatch batch;
+    batch.m_pool = m_pool;
+    batch.m_block = m_pool->take();
+    auto & block = *batch.m_block;
+    auto const count = m_options.batch;
+    for (std::size_t i = 0; i != count; ++i) {
+        auto & hdr = block.headers[i].msg_hdr;
+        hdr = {};
+        hdr.msg_name = &block.peers[i];
+        hdr.msg_namelen = sizeof(block.peers[i]);
+        hdr.msg_iov = &block.iov[i];
+        hdr.msg_iovlen = 1;
+        if (m_gro) {
+            hdr.msg_control = block.control.data() + i * gro_control;
+            hdr.msg_controllen = gro_control;
+        }
+    }
+    auto got = recvmmsg(m_fd, block.headers.data(), static_cast<unsigned int>(count), MSG_DONTWAIT, nullptr);
+    if (got < 0) {
+        // A connected socket hears about ICMP errors this way; it's already been cleared by telling us.
+        if (would_block(errno) || errno == ECONNREFUSED) return batch;
+        throw covent_runtime_error(std::strerror(errno));
+    }
+    ++m_stats.batches;
+    for (std::size_t i = 0; i != static_cast<std::size_t>(got); ++i) {
+        auto const & hdr = block.headers[i].msg_hdr;
+        auto const len = std::min<std::size_t>(block.headers[i].msg_len, m_slot_size);
+        auto const * data = static_cast<char const *>(block.iov[i].iov_base);
+        auto const * peer = hdr.msg_namelen ? sockaddr_cast<AF_UNSPEC>(&block.peers[i]) : nullptr;
+        if (hdr.msg_flags & MSG_TRUNC) ++m_stats.truncated;
+        std::size_t segment = 0;
+#ifdef UDP_GRO
+        for (auto * cmsg = CMSG_FIRSTHDR(&hdr); m_gro && cmsg; cmsg = CMSG_NXTHDR(const_cast<struct msghdr *>(&hdr), cmsg)) {
+            if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+                int size;
+                std::memcpy(&size, CMSG_DATA(cmsg), sizeof(size));
+                segment = static_cast<std::size_t>(size);
+            }
+        }
+#endif
+        if (segment && segment < len) {
+            // Several datagrams from one peer, coalesced; all segment octets long but the last.
+            for (std::size_t off = 0; off < len; off += segment) {
+                batch.m_datagrams.push_back({{data + off, std::min(segment, len - off)}, peer});
+                ++m_stats.coalesced;
+            }
+        } else {
+            batch.m_datagrams.push_back({{data, len}, peer});
+        }
+    }
+    m_stats.received += batch.m_datagrams.size();
+    return batch;
+}
+
+covent::task<covent::DatagramBatch> covent::DatagramEndpoint::recv_batch() {
+    for (;;) {
+        auto batch = try_recv();
+        if (!batch.empty()) co_return batch;
+        co_await ready(*this, EV_READ);
+    }
+}
+
+std::size_t covent::DatagramEndpoint::try_send(std::span<Datagram const> datagrams) {
+    std::size_t sent = 0;
+    while (sent != datagrams.size()) {
+        auto n = send_some(datagrams.subspan(sent));
+        if (!n) break;
+        sent += n;
+    }
+    m_stats.sent += sent;
+    return sent;
+}
+
+// One sendmmsg's worth. Returns the number of datagrams sent, zero if it would block.
+std::size_t covent::DatagramEndpoint::send_some(std::span<Datagram const> datagrams) {
+    std::array<struct mmsghdr, send_messages> headers;
+    std::array<std::size_t, send_messages> counts; // Datagrams in each message.
+    std::array<struct iovec, send_iov> iov;
+    alignas(struct cmsghdr) std::array<char, send_messages * gso_control> control;
+    std::size_t messages = 0;
+    std::size_t iovs = 0;
+    bool coalesced = false;
+    for (std::size_t i = 0; i != datagrams.size() && messages != send_messages && iovs != send_iov;) {
+        // Take the longest run we can send as one: same peer, all the same size bar a shorter last one.
+        auto const & first = datagrams[i];
+        if (!first.peer && !m_connected) throw covent_logic_error("Datagram has no peer, and the endpoint isn't connected");
+        std::size_t run = 1;
+        if (m_gso && !first.data.empty() && first.data.size() <= m_gso_segment) {
+            auto total = first.data.size();
+            while (i + run != datagrams.size() && run != gso_max_segments && iovs + run != send_iov) {
+                auto const & next = datagrams[i + run];
+                if (next.data.empty() || next.data.size() > first.data.size() || total + next.data.size() > gso_max_size) break;
+                if (!same_peer(first.peer, next.peer)) break;
+                total += next.data.size();
+                ++run;
+                if (next.data.size() < first.data.size()) break;
+            }
+        }
+        auto & hdr = headers[messages].msg_hdr;
+        hdr = {};
+        hdr.msg_name = const_cast<struct sockaddr *>(first.peer);
+        hdr.msg_namelen = first.peer ? sockaddr_len(first.peer) : 0;
+        hdr.msg_iov = &iov[iovs];
+        hdr.msg_iovlen = run;
+        for (std::size_t j = 0; j != run; ++j) {
+            auto const & d = datagrams[i + j];
+            iov[iovs++] = {const_cast<char *>(d.data.data()), d.data.size()};
+        }
+#ifdef UDP_SEGMENT
+        if (run > 1) {
+            hdr.msg_control = control.data() + messages * gso_control;
+            hdr.msg_controllen = gso_control;
+            auto * cmsg = CMSG_FIRSTHDR(&hdr);
+            cmsg->cmsg_level = SOL_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(std::uint16_t));
+            auto segment = static_cast<std::uint16_t>(first.data.size());
+            std::memcpy(CMSG_DATA(cmsg), &segment, sizeof(segment));
+        }
+#endif
+        coalesced = coalesced || run > 1;
+        counts[messages++] = run;
+        i += run;
+    }
+    for (;;) {
+        auto done = sendmmsg(m_fd, headers.data(), static_cast<unsigned int>(messages), MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (done >= 0) {
+            ++m_stats.send_calls;
+            std::size_t sent = 0;
+            for (std::size_t m = 0; m != static_cast<std::size_t>(done); ++m) sent += counts[m];
+            return sent;
+        }
+        if (would_block(errno)) return 0;
+        if (errno == ECONNREFUSED) continue; // An earlier datagram's ICMP error, now reported and cleared.
+        if ((errno == EIO || errno == EINVAL || errno == EMSGSIZE) && coalesced) {
+            // Either the route's device can't checksum for GSO, or a segment's bigger than the path will take
+            // (a tunnel, say); go without from now on.
+            m_gso = false;
+            return send_some(datagrams);
+        }
+        throw covent_runtime_error(std::strerror(errno));
+    }
+}
+
+covent::task<void> covent::DatagramEndpoint::send_batch(std::span<Datagram const> datagrams) {
+    while (!datagrams.empty()) {
+        datagrams = datagrams.subspan(try_send(datagrams));
+        if (!datagrams.empty()) co_await ready(*this, EV_WRITE);
+    }
+}
@@ -0,0 +1,178 @@
+//
+// Created by dwd on 10/17/26.
+//
+
+#include <covent/frame-pool.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+    constexpr std::size_t granularity = 64;
+    constexpr std::size_t small_classes = 32; // 64-octet steps, up to 2KiB.
+    constexpr std::size_t large_classes = 9; // Then powers of two, up to 1MiB.
+    constexpr std::size_t classes = small_classes + large_classes;
+    constexpr std::uint32_t unpooled = ~std::uint32_t{0};
+    constexpr std::uint32_t unpooled_bit = std::uint32_t{1} << 31; // Marks an unpooled frame's generation.
+
+    std::size_t class_of(std::size_t size) {
+        if (size <= small_classes * granularity) return size ? (size - 1) / granularity : 0;
+        std::size_t c = small_classes;
+        for (auto limit = small_classes * granularity * 2; limit < size; limit *= 2) ++c;
+        return c;
+    }
+    std::size_t class_size(std::size_t c) {
+        if (c < small_classes) return (c + 1) * granularity;
+        return (small_classes * granularity) << (c - small_classes + 1);
+    }
+
+    struct Pool;
+
+    // Sits in front of every frame, keeping the frame itself suitably aligned. Pooled frame memory is never
+    // handed back to the heap, so the generation here stays readable after the frame is gone.
+    struct alignas(alignof(std::max_align_t)) Header {
+        Pool * owner;
+        std::uint32_t size_class;
+        std::atomic<std::uint32_t> generation;
+    };
+
+    struct FreeBlock {
+        FreeBlock * next;
+    };
+
+    struct Pool {
+        std::array<FreeBlock *, classes> free = {};
+        std::atomic<FreeBlock *> remote = nullptr; // Frees from other threads, any class.
+
+        // Put back everything other threads have handed us.
+        void reclaim() {
+            auto * block = remote.exchange(nullptr, std::memory_order_acquire);
+            while (block) {
+                auto * next = block->next;
+                local_free(reinterpret_cast<Header *>(block));
+                block = next;
+            }
+        }
+
+        void local_free(Header * header) {
+            // The header's first word doubles as the freelist link; owner is rewritten on allocation.
+            auto * block = reinterpret_cast<FreeBlock *>(header);
+            block->next = free[header->size_class];
+            free[header->size_class] = block;
+        }
+
+        void remote_free(Header * header) {
+            auto * block = reinterpret_cast<FreeBlock *>(header);
+            block->next = remote.load(std::memory_order_relaxed);
+            while (!remote.compare_exchange_weak(block->next, block, std::memory_order_release, std::memory_order_relaxed)) {
+                // Retry.
+            }
+        }
+    };
+
+    // Pools outlive their threads: when a thread exits, its pool (and everything cached in it) is left for the
+    // next new thread to adopt. Frames freed in the meantime just queue up on its remote list.
+    std::mutex s_orphans_mutex;
+    std::vector<Pool *> s_orphans;
+    thread_local Pool * s_pool = nullptr; // Trivially destructible, so still safe to look at during thread exit.
+
+    struct PoolHolder {
+        Pool * pool;
+        PoolHolder() {
+            {
+                std::scoped_lock l_(s_orphans_mutex);
+                if (!s_orphans.empty()) {
+                    pool = s_orphans.back();
+                    s_orphans.pop_back();
+                } else {
+                    pool = new Pool;
+                }
+            }
+            s_pool = pool;
+        }
+        ~PoolHolder() {
+            s_pool = nullptr;
+            std::scoped_lock l_(s_orphans_mutex);
+            s_orphans.push_back(pool);
+        }
+    };
+
+    Pool * thread_pool() {
+        static thread_local PoolHolder holder;
+        return holder.pool;
+    }
+
+    Header * header_of(void const * frame) {
+        return const_cast<Header *>(static_cast<Header const *>(frame) - 1);
+    }
+
+    // Frames too big for any class go back to the heap, so their liveness can't live in their header.
+    // Instead each gets a serial, recorded here against its address for as long as it's alive.
+    std::mutex s_unpooled_mutex;
+    std::unordered_map<void const *, std::uint32_t> s_unpooled;
+    std::uint32_t s_unpooled_serial = 0;
+}
+
+void * covent::detail::frame_allocate(std::size_t size) {
+    auto c = class_of(size);
+    if (c >= classes) {
+        // Rare enough not to be worth pooling.
+        auto * header = new (::operator new(sizeof(Header) + size)) Header{nullptr, unpooled, 0};
+        std::scoped_lock l_(s_unpooled_mutex);
+        auto serial = (++s_unpooled_serial & ~unpooled_bit) | unpooled_bit;
+        header->generation.store(serial, std::memory_order_relaxed);
+        s_unpooled[header + 1] = serial;
+        return header + 1;
+    }
+    auto * pool = thread_pool();
+    if (!pool->free[c]) pool->reclaim();
+    Header * header;
+    if (auto * block = pool->free[c]; block) {
+        pool->free[c] = block->next;
+        header = reinterpret_cast<Header *>(block);
+    } else {
+        header = new (::operator new(sizeof(Header) + class_size(c))) Header{nullptr, 0, 0};
+    }
+    header->owner = pool;
+    header->size_class = static_cast<std::uint32_t>(c);
+    return header + 1;
+}
+
+void covent::detail::frame_deallocate(void * ptr, std::size_t) noexcept {
+    if (!ptr) return;
+    auto * header = header_of(ptr);
+    if (header->size_class == unpooled) {
+        {
+            std::scoped_lock l_(s_unpooled_mutex);
+            s_unpooled.erase(ptr);
+        }
+        header->~Header();
+        ::operator delete(header);
+        return;
+    }
+    header->generation.fetch_add(1, std::memory_order_release);
+    if (auto * owner = header->owner; owner == s_pool) {
+        owner->local_free(header);
+    } else {
+        owner->remote_free(header);
+    }
+}
+
+std::uint32_t covent::detail::frame_generation(void const * frame) noexcept {
+    auto generation = header_of(frame)->generation.load(std::memory_order_acquire);
+    return header_of(frame)->size_class == unpooled ? generation : generation & ~unpooled_bit;
+}
+
+bool covent::detail::frame_alive(void const * frame, std::uint32_t generation) noexcept {
+    if (generation & unpooled_bit) {
+        // The frame may be gone, and its memory someone else's; only the registry is safe to look at.
+        std::scoped_lock l_(s_unpooled_mutex);
+        auto it = s_unpooled.find(frame);
+        return it != s_unpooled.end() && it->second == generation;
+    }
+    return (header_of(frame)->generation.load(std::memory_order_acquire) & ~unpooled_bit) == generation;
+}
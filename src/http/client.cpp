@@ -28,6 +28,10 @@ public:
         auto tmp = message->process(data);
         if (message->complete) {
             ready.resolve(true);
+        } else if (message->want_line) {
+            need_delimiter("\r\n");
+        } else if (message->want_octets) {
+            need_octets(message->want_octets);
         }
         co_return tmp;
     }
@@ -51,67 +55,39 @@ Request Client::request(Method method, std::string_view uri, std::optional<std::
     return Request(*this, method, URI(uri));
 }
 
-covent::task<std::shared_ptr<Client::HTTPSession>> Client::connect(covent::dns::answers::Address address, URI const & uri) const {
+covent::task<std::shared_ptr<Client::HTTPSession>> Client::connect(std::vector<struct sockaddr_storage> addresses, URI const & uri) const {
     bool ssl = false;
     if (uri.scheme == "https") {
         ssl = true;
     }
-    bool success = false;
     auto session = std::make_shared<HTTPSession>(m_loop); // Don't add it to the loop yet!
     auto & tls_context = m_service.entry(uri.host).tls_context();
     auto & validator = m_service.entry(uri.host).validator();
-    for (auto & s : address.addr) {
-        try {
-            covent::sockaddr_cast<AF_INET6>(&s)->sin6_port = htons(uri.port.value());
-            co_await session->connect(&s);
-            if (ssl) {
-                co_await session->ssl(tls_context.instantiate(true, uri.host), true);
-                co_await validator.verify_tls(session->ssl(), uri.host);
-            }
-            success = true;
-            break;
-        } catch (std::runtime_error & e) {
-            m_log->info("Error {}, ignoring", e.what());
-            // Loop around and try again.
-        }
+    for (auto & s : addresses) {
+        covent::sockaddr_cast<AF_INET6>(&s)->sin6_port = htons(uri.port.value()); // Same place for both families.
     }
-    if (!success) {
-        session.reset();
-    } else {
-        m_loop.add(session);
+    try {
+        co_await session->connect_any(addresses, {.timeout = 5});
+        if (ssl) {
+            co_await session->ssl(tls_context.instantiate(true, uri.host), true);
+            co_await validator.verify_tls(session->ssl(), uri.host);
+        }
+    } catch (std::runtime_error & e) {
+        m_log->info("Error {}", e.what());
+        co_return nullptr;
     }
+    m_loop.add(session);
     co_return session;
 }
 
 covent::task<std::unique_ptr<Response>> Client::send(Request const &r) {
-    std::shared_ptr<Client::HTTPSession> session;
-    std::list<task<std::shared_ptr<HTTPSession>>> attempts;
-
     auto const & uri = r.uri();
     auto & resolver = m_service.entry(uri.host).resolver();
     auto [addr_v4, addr_v6] = co_await gather(resolver.address_v4(uri.host), resolver.address_v6(uri.host));
-
-    if (!addr_v6.addr.empty()) {
-        attempts.emplace_back(connect(addr_v6, uri));
-        try {
-            session = co_await race(attempts, 0.1, [](auto const & x) { return !!x; });
-        } catch (covent::race_timeout &) { // NOSONAR
-            // Carry on!
-        }
-    }
-    if (!session) {
-        if (!attempts.empty() && attempts.rbegin()->done()) {
-            attempts.clear();
-        }
-        if (!addr_v4.addr.empty()) {
-            attempts.emplace_back(connect(addr_v4, uri));
-        }
-        try {
-            session = co_await race(attempts, 5, [](auto const & x) { return !!x; });
-        } catch (covent::race_timeout &) { // NOSONAR
-            // Carry on!
-        }
-    }
+    // connect_any() interleaves the families itself.
+    auto addresses = std::move(addr_v6.addr);
+    addresses.insert(addresses.end(), addr_v4.addr.begin(), addr_v4.addr.end());
+    auto session = co_await connect(std::move(addresses), uri);
     if (!session) {
         throw std::runtime_error("Connection failed");
     }
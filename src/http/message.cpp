@@ -22,6 +22,7 @@ unsigned long Message::process_status(std::string_view &data) {
     // http_version SP status_code SP status_reason CR LF
     auto crlf = data.find("\r\n");
     if (crlf == std::string_view::npos) {
+        want_line = true;
         return 0;
     }
     auto ver_space = data.find(' ');
@@ -45,6 +46,7 @@ unsigned long Message::process_header(std::string_view &data) {
     // Parse out headers. We ignore folding.
     auto crlf = data.find("\r\n");
     if (crlf == std::string_view::npos) {
+        want_line = true;
         return read;
     }
     if (crlf == 0) {
@@ -106,6 +108,7 @@ std::tuple<unsigned long, unsigned long> Message::read_body_chunk_header(std::st
     unsigned long chunk = 0;
     auto crlf = data.find("\r\n");
     if (crlf == std::string_view::npos) {
+        want_line = true;
         return {0, 0};
     }
     auto colon = data.find(';');
@@ -167,10 +170,12 @@ unsigned long Message::read_body_chunked(std::string_view & data) {
             }
         } else {
             auto status  = read_body_chunk_normal(data, chunk_len);
-            chunk += status;
             if (status == 0) {
+                // This chunk's header goes unused too, so it'll be seen again.
+                want_octets = chunk + chunk_len + 2;
                 return read;
             }
+            chunk += status;
         }
         read += chunk;
     }
@@ -179,6 +184,8 @@ unsigned long Message::read_body_chunked(std::string_view & data) {
 
 unsigned long Message::process(std::string_view data) {
     unsigned long int read = 0;
+    want_line = false;
+    want_octets = 0;
     if (status_code == -1) {
         auto status = process_status(data);
         read += status;
@@ -7,6 +7,7 @@
 
 #include "covent/http.h"
 #include "covent/covent.h"
+#include <array>
 
 using namespace covent::http;
 
@@ -41,7 +42,8 @@ covent::task<std::unique_ptr<Response>> Request::operator()() {
 }
 
 void Request::send(Session & sess) const {
-    sess.write(m_request->render_request(method));
-    sess.write(m_request->render_header());
-    sess.write(m_request->render_body());
+    auto request_line = m_request->render_request(method);
+    auto header = m_request->render_header();
+    std::array<std::string_view, 3> parts{request_line, header, m_request->body};
+    sess.write(parts);
 }
\ No newline at end of file
@@ -3,11 +3,16 @@
 //
 #include <covent/http.h>
 #include <covent/loop.h>
+#include <covent/sockaddr-cast.h>
 #include <event2/buffer.h>
 #include <event2/http.h>
 #include <algorithm>
+#include <charconv>
+#include <cstring>
 #include <utility>
 #include <event2/bufferevent_ssl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using namespace covent::http;
 
@@ -59,6 +64,44 @@ namespace {
 		}
 	};
 
+	struct ByteRange {
+		ev_off_t first;
+		ev_off_t last;
+	};
+
+	// A single "bytes=" range, clamped to size. Nothing if there's no range we can honour, in which case the
+	// whole file is sent; an empty range (first > last) if it's unsatisfiable.
+	std::optional<ByteRange> parse_range(char const * header, ev_off_t size) {
+		if (!header) return std::nullopt;
+		std::string_view spec{header};
+		if (!spec.starts_with("bytes=")) return std::nullopt;
+		spec.remove_prefix(6);
+		if (spec.find(',') != std::string_view::npos) return std::nullopt; // Multiple ranges; we needn't.
+		auto dash = spec.find('-');
+		if (dash == std::string_view::npos) return std::nullopt;
+		auto number = [](std::string_view s, ev_off_t & out) {
+			auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), out);
+			return ec == std::errc{} && end == s.data() + s.size();
+		};
+		ev_off_t first = 0;
+		ev_off_t last = size - 1;
+		if (dash == 0) {
+			ev_off_t suffix = 0; // Final octets.
+			if (!number(spec.substr(1), suffix)) return std::nullopt;
+			if (suffix == 0) return ByteRange{1, 0};
+			first = std::max<ev_off_t>(size - suffix, 0);
+		} else {
+			if (!number(spec.substr(0, dash), first)) return std::nullopt;
+			if (dash + 1 != spec.size()) {
+				if (!number(spec.substr(dash + 1), last)) return std::nullopt;
+				if (last < first) return std::nullopt;
+				last = std::min(last, size - 1);
+			}
+		}
+		if (first >= size) return ByteRange{1, 0};
+		return ByteRange{first, last};
+	}
+
 	std::optional<std::unordered_map<std::string, std::string>> matchCompiled(const detail::CompiledTemplate& ct, const std::string& path, std::unordered_map<std::string, std::string> const & pre)
 	{
 		PathSegmentIterator it(path);
@@ -175,7 +218,7 @@ covent::task<int> Endpoint::handler(evhttp_request * req, std::unordered_map<std
 	return m_handler(req, pre);
 }
 
-Server::Server(unsigned short port, bool tls) {
+Server::Server(bool tls) {
 	auto & loop = covent::Loop::thread_loop();
 	m_service = std::make_unique<Service>();
 	if (!tls) {
@@ -183,11 +226,38 @@ Server::Server(unsigned short port, bool tls) {
 		entry.make_tls_context(false, false, "");
 	}
     m_server = evhttp_new(loop.event_base());
+    evhttp_set_bevcb(m_server, bufferevent_cb, this);
+    evhttp_set_gencb(m_server, request_cb, this);
+}
+
+Server::Server(unsigned short port, bool tls) : Server(tls) {
     if (0 != evhttp_bind_socket(m_server, "::", port)) {
 	    throw std::runtime_error(std::strerror(errno));
     }
-    evhttp_set_bevcb(m_server, bufferevent_cb, this);
-    evhttp_set_gencb(m_server, request_cb, this);
+}
+
+Server::Server(std::string const & path, bool tls) : Server(tls) {
+	auto addr = covent::unix_sockaddr(path);
+	// Once this body runs we're fully constructed, so a throw from here still gets the destructor.
+	if (path.front() != '@') m_path = path;
+	auto sock = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock < 0) throw std::runtime_error(std::strerror(errno));
+	evutil_make_socket_nonblocking(sock);
+	evutil_make_socket_closeonexec(sock);
+	// A stale socket from an earlier run would make bind fail; anything that isn't a socket is left alone.
+	struct stat st = {};
+	if (!m_path.empty() && ::lstat(m_path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) ::unlink(m_path.c_str());
+	if (::bind(sock, covent::sockaddr_cast<AF_UNSPEC>(&addr), covent::sockaddr_len(&addr)) != 0) {
+		auto error = std::strerror(errno);
+		evutil_closesocket(sock);
+		m_path.clear(); // Not ours to remove.
+		throw std::runtime_error(error);
+	}
+	if (::listen(sock, SOMAXCONN) != 0 || !evhttp_accept_socket_with_handle(m_server, sock)) {
+		auto error = std::strerror(errno);
+		evutil_closesocket(sock);
+		throw std::runtime_error(error);
+	}
 }
 
 void Server::add(std::unique_ptr<Endpoint> && endpoint) {
@@ -248,4 +318,52 @@ covent::task<void> Server::handler_low(struct evhttp_request *req) {
 
 Server::~Server() {
 	evhttp_free(m_server);
-}
\ No newline at end of file
+	if (!m_path.empty()) ::unlink(m_path.c_str());
+}
+int covent::http::send_file(struct evhttp_request * req, int fd, std::string_view content_type) {
+	struct stat st;
+	if (::fstat(fd, &st) != 0) throw exception::internal(std::strerror(errno));
+	ev_off_t const size = st.st_size;
+	auto * headers = evhttp_request_get_output_headers(req);
+	evhttp_add_header(headers, "Accept-Ranges", "bytes");
+	if (!content_type.empty()) evhttp_add_header(headers, "Content-Type", std::string(content_type).c_str());
+	ev_off_t first = 0;
+	ev_off_t length = size;
+	int status = HTTP_OK;
+	if (auto range = parse_range(evhttp_find_header(evhttp_request_get_input_headers(req), "Range"), size); range) {
+		if (range->first > range->last) {
+			evhttp_add_header(headers, "Content-Range", ("bytes */" + std::to_string(size)).c_str());
+			evhttp_send_reply(req, 416, "Range Not Satisfiable", nullptr);
+			return 416;
+		}
+		first = range->first;
+		length = range->last - range->first + 1;
+		status = 206;
+		auto content_range = "bytes " + std::to_string(range->first) + "-" + std::to_string(range->last) + "/" + std::to_string(size);
+		evhttp_add_header(headers, "Content-Range", content_range.c_str());
+	}
+	evhttp_add_header(headers, "Content-Length", std::to_string(length).c_str());
+	auto * reply = evbuffer_new();
+	// evhttp moves the reply into the connection's output; say where it's going so libevent uses sendfile,
+	// unless TLS is in the way, when it'll map the file instead.
+	auto * bev = evhttp_connection_get_bufferevent(evhttp_request_get_connection(req));
+	if (bev && !bufferevent_openssl_get_ssl(bev)) evbuffer_set_flags(reply, EVBUFFER_FLAG_DRAINS_TO_FD);
+	if (length > 0) {
+		auto own = ::dup(fd);
+		auto * segment = own < 0 ? nullptr : evbuffer_file_segment_new(own, first, length, EVBUF_FS_CLOSE_ON_FREE);
+		if (!segment) {
+			if (own >= 0) ::close(own);
+			evbuffer_free(reply);
+			throw exception::internal("Couldn't open file segment");
+		}
+		auto rc = evbuffer_add_file_segment(reply, segment, 0, -1);
+		evbuffer_file_segment_free(segment);
+		if (rc != 0) {
+			evbuffer_free(reply);
+			throw exception::internal("Couldn't add file segment");
+		}
+	}
+	evhttp_send_reply(req, status, status == 206 ? "Partial Content" : "OK", reply);
+	evbuffer_free(reply);
+	return status;
+}
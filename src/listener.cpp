@@ -4,42 +4,167 @@
 
 #include <covent/core.h>
 #include <covent/loop.h>
+#include <covent/loop-group.h>
 #include <event2/listener.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <future>
 
-covent::ListenerBase::ListenerBase(covent::Loop &loop, std::string const & address, unsigned short port) :m_loop(loop), m_port(port), m_sockaddr() {
-    std::memset(&m_sockaddr, 0, sizeof(m_sockaddr)); // Clear, to avoid valgrind complaints later.
-    if (1 == inet_pton(AF_INET6, address.c_str(), &(covent::sockaddr_cast<AF_INET6>(&m_sockaddr)->sin6_addr))) {
-        auto *sa = covent::sockaddr_cast<AF_INET6>(&m_sockaddr);
-        sa->sin6_family = AF_INET6;
-        sa->sin6_port = htons(port);
-    } else if (1 == inet_pton(AF_INET, address.c_str(), &(covent::sockaddr_cast<AF_INET>(&m_sockaddr)->sin_addr))) {
-        auto *sa = covent::sockaddr_cast<AF_INET>(&m_sockaddr);
-        sa->sin_family = AF_INET;
-        sa->sin_port = htons(port);
-    } else {
-        throw std::runtime_error("Couldn't understand address syntax " + std::string(address));
-    }
+struct covent::ListenerBase::Shard {
+    ListenerBase * listener;
+    Loop * loop;
+    struct evconnlistener * listener_ev = nullptr;
+    // Accepted just as we paused; it goes first when we resume.
+    evutil_socket_t held = -1;
+    struct sockaddr_storage held_addr = {};
+    int held_len = 0;
+    TimerHandle recheck;
+};
+
+covent::ListenerBase::ListenerBase(covent::Loop &loop, std::string const & address, unsigned short port, SocketOptions options) :m_loop(loop), m_port(port), m_sockaddr(), m_options(std::move(options)) {
+    m_sockaddr = parse_sockaddr(address, port); // The port is ignored for Unix sockets.
 }
 
 const struct sockaddr *covent::ListenerBase::sockaddr() const {
     return sockaddr_cast<AF_UNSPEC>(&m_sockaddr);
 }
 
-void covent::ListenerBase::session_connected(int sock, struct sockaddr const *, int) {
-    create_session(sock);
+void covent::ListenerBase::session_connected(Loop & loop, evutil_socket_t sock, struct sockaddr const *, int) {
+    create_session(loop, sock);
+}
+
+void covent::ListenerBase::shed(Loop &, evutil_socket_t sock) {
+    evutil_closesocket(sock);
+}
+
+covent::ListenerBase::AdmissionStats covent::ListenerBase::admission_stats() const {
+    return {m_accepted.load(), m_shed.load(), m_paused.load(), m_sessions->load()};
+}
+
+bool covent::ListenerBase::admit(Loop & loop) const {
+    if (m_admission.max_sessions && *m_sessions >= m_admission.max_sessions) return false;
+    if (loop.max_sessions() && loop.session_count() >= loop.max_sessions()) return false;
+    if (m_admission.max_lag > 0 && loop.lag() > m_admission.max_lag) return false;
+    return true;
+}
+
+void covent::ListenerBase::accept_cb(struct evconnlistener *, evutil_socket_t sock, struct sockaddr * addr, int len, void * arg) {
+    auto * shard = static_cast<Shard *>(arg);
+    auto & listener = *shard->listener;
+    auto & loop = *shard->loop;
+    if (listener.admit(loop)) {
+        ++listener.m_accepted;
+        listener.session_connected(loop, sock, addr, len);
+    } else if (listener.m_admission.overload == Admission::Overload::shed) {
+        ++listener.m_shed;
+        listener.shed(loop, sock);
+    } else {
+        shard->held = sock;
+        shard->held_len = std::min(len, static_cast<int>(sizeof(shard->held_addr)));
+        std::memcpy(&shard->held_addr, addr, static_cast<std::size_t>(shard->held_len));
+        listener.pause(*shard);
+    }
+}
+
+// Disabling from within the accept callback also stops libevent accepting any more this time round.
+void covent::ListenerBase::pause(Shard & shard) {
+    evconnlistener_disable(shard.listener_ev);
+    ++m_paused;
+    shard.recheck = shard.loop->defer([this, &shard]() { recheck(shard); }, m_admission.recheck);
 }
 
-namespace {
-    void listener_connect_cb(struct evconnlistener *, evutil_socket_t sock, struct sockaddr * addr, int len, void * arg) {
-        auto listener = static_cast<covent::ListenerBase *>(arg);
-        listener->session_connected(sock, addr, len);
+void covent::ListenerBase::recheck(Shard & shard) {
+    auto & loop = *shard.loop;
+    if (!admit(loop)) {
+        shard.recheck = loop.defer([this, &shard]() { recheck(shard); }, m_admission.recheck);
+        return;
+    }
+    if (shard.held >= 0) {
+        ++m_accepted;
+        session_connected(loop, std::exchange(shard.held, -1), sockaddr_cast<AF_UNSPEC>(&shard.held_addr), shard.held_len);
+    }
+    evconnlistener_enable(shard.listener_ev);
+}
+
+// Set up the socket ourselves rather than with evconnlistener_new_bind, so the options go on before listen().
+covent::ListenerBase::Shard & covent::ListenerBase::bind(covent::Loop & loop, bool reuse_port) {
+    auto & shard = *m_shards.emplace_back(std::make_unique<Shard>(Shard{this, &loop}));
+    auto sock = ::socket(m_sockaddr.ss_family, SOCK_STREAM, 0);
+    if (sock < 0) return shard;
+    evutil_make_socket_nonblocking(sock);
+    evutil_make_socket_closeonexec(sock);
+    evutil_make_listen_socket_reuseable(sock);
+    if (reuse_port) evutil_make_listen_socket_reuseable_port(sock);
+    try {
+        apply(sock, m_options, true);
+    } catch (...) {
+        evutil_closesocket(sock);
+        throw;
+    }
+    unlink_socket(m_sockaddr); // Left behind by an earlier run.
+    if (::bind(sock, sockaddr(), sockaddr_len(&m_sockaddr)) != 0 || ::listen(sock, m_options.backlog < 0 ? SOMAXCONN : m_options.backlog) != 0) {
+        evutil_closesocket(sock);
+        return shard;
+    }
+    // A zero backlog tells libevent we've already listened.
+    shard.listener_ev = evconnlistener_new(loop.event_base(), accept_cb, &shard, LEV_OPT_CLOSE_ON_FREE, 0, sock);
+    if (!shard.listener_ev) {
+        evutil_closesocket(sock);
+    } else if (m_admission.max_lag > 0) {
+        loop.measure_lag();
     }
+    return shard;
 }
 
 void covent::ListenerBase::listen(covent::Loop & loop) {
-    m_listener = evconnlistener_new_bind(loop.event_base(), listener_connect_cb, this, LEV_OPT_CLOSE_ON_FREE | LEV_OPT_REUSEABLE, -1, sockaddr(), sizeof(struct sockaddr_storage));
+    bind(loop, false);
+}
+
+void covent::ListenerBase::listen(covent::LoopGroup & group) {
+    if (m_sockaddr.ss_family == AF_UNIX) {
+        throw covent_logic_error("Unix socket listeners can't be shared across a LoopGroup");
+    }
+    // Each listener is created on its own loop's thread, so that loop alone ever touches it.
+    for (std::size_t i = 0; i != group.size(); ++i) {
+        auto & loop = group.loop(i);
+        std::promise<struct evconnlistener *> bound;
+        auto result = bound.get_future();
+        loop.post([this, &loop, &bound]() {
+            try {
+                bound.set_value(bind(loop, true).listener_ev);
+            } catch (...) {
+                bound.set_exception(std::current_exception());
+            }
+        });
+        if (!result.get()) {
+            throw covent_runtime_error("Couldn't bind listener on group loop " + std::to_string(i));
+        }
+    }
 }
 
 covent::ListenerBase::~ListenerBase() {
-    if (m_listener) evconnlistener_free(m_listener);
-}
\ No newline at end of file
+    for (auto & shard : m_shards) {
+        if (!shard->listener_ev) continue;
+        auto & loop = *shard->loop;
+        auto close = [&shard]() {
+            shard->recheck.cancel();
+            if (shard->held >= 0) evutil_closesocket(shard->held);
+            evconnlistener_free(shard->listener_ev);
+        };
+        if (loop.on_loop_thread() || loop.stopped()) {
+            close();
+        } else {
+            // Free it on its own thread, so we can't pull it out from under an accept in progress.
+            std::promise<void> freed;
+            loop.post([&close, &freed]() {
+                close();
+                freed.set_value();
+            });
+            freed.get_future().wait();
+        }
+    }
+    if (m_sockaddr.ss_family == AF_UNIX && std::ranges::any_of(m_shards, [](auto const & shard) { return shard->listener_ev != nullptr; })) {
+        unlink_socket(m_sockaddr);
+    }
+}
@@ -0,0 +1,77 @@
+//
+// Created by dwd on 10/17/26.
+//
+
+#include <covent/loop-group.h>
+#include <covent/core.h>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+    void pin_thread(std::size_t index) {
+#ifdef __linux__
+        // Pick the index'th CPU we're allowed to run on, wrapping if there are more loops than CPUs.
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return;
+        auto count = static_cast<std::size_t>(CPU_COUNT(&allowed));
+        if (count == 0) return;
+        auto target = index % count;
+        for (int cpu = 0; cpu != CPU_SETSIZE; ++cpu) {
+            if (!CPU_ISSET(cpu, &allowed)) continue;
+            if (target-- == 0) {
+                cpu_set_t mine;
+                CPU_ZERO(&mine);
+                CPU_SET(cpu, &mine);
+                pthread_setaffinity_np(pthread_self(), sizeof(mine), &mine);
+                return;
+            }
+        }
+#endif
+    }
+}
+
+covent::LoopGroup::LoopGroup(std::size_t size, bool pin) : m_loops(size ? size : 1) {
+    std::vector<std::future<void>> started;
+    for (std::size_t i = 0; i != m_loops.size(); ++i) {
+        std::promise<void> ready;
+        started.emplace_back(ready.get_future());
+        // Each Loop has to be created on the thread that runs it.
+        m_threads.emplace_back([this, i, pin, ready = std::move(ready)]() mutable {
+            if (pin) pin_thread(i);
+            m_loops[i] = std::make_unique<Loop>();
+            ready.set_value();
+            m_loops[i]->run();
+        });
+    }
+    for (auto & f : started) f.wait();
+}
+
+covent::LoopGroup::~LoopGroup() {
+    shutdown();
+    m_loops.clear();
+}
+
+covent::Loop & covent::LoopGroup::loop(std::size_t index) const {
+    if (index >= m_loops.size()) throw covent_logic_error("No such loop in group");
+    return *m_loops[index];
+}
+
+covent::Loop & covent::LoopGroup::next() {
+    return *m_loops[m_next.fetch_add(1, std::memory_order_relaxed) % m_loops.size()];
+}
+
+void covent::LoopGroup::listen(ListenerBase & listener) {
+    listener.listen(*this);
+}
+
+void covent::LoopGroup::shutdown() {
+    for (auto & loop : m_loops) {
+        if (loop) loop->shutdown();
+    }
+    for (auto & thread : m_threads) {
+        if (thread.joinable()) thread.join();
+    }
+}
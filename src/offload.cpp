@@ -0,0 +1,112 @@
+//
+// Created by dwd on 10/17/26.
+//
+
+#include <covent/offload.h>
+
+namespace {
+    // Which pool (if any) the current thread works for, and its index there.
+    thread_local covent::OffloadPool const * s_pool = nullptr;
+    thread_local std::size_t s_worker = 0;
+}
+
+covent::OffloadPool::OffloadPool(std::size_t threads) {
+    if (threads == 0) threads = 1;
+    for (std::size_t i = 0; i != threads; ++i) {
+        m_workers.emplace_back(std::make_unique<Worker>());
+    }
+    for (std::size_t i = 0; i != threads; ++i) {
+        m_threads.emplace_back([this, i]() {
+            run(i);
+        });
+    }
+}
+
+covent::OffloadPool::~OffloadPool() {
+    {
+        std::scoped_lock l_(m_sleep_mutex);
+        m_stop = true;
+    }
+    m_sleep.notify_all();
+    for (auto & thread : m_threads) {
+        thread.join();
+    }
+}
+
+covent::OffloadPool & covent::OffloadPool::pool() {
+    static OffloadPool s_default(std::max(2u, std::thread::hardware_concurrency()) - 1);
+    return s_default;
+}
+
+void covent::OffloadPool::submit(std::function<void()> && fn) {
+    std::size_t index;
+    if (s_pool == this) {
+        index = s_worker;
+    } else {
+        index = m_next.fetch_add(1, std::memory_order_relaxed) % m_workers.size();
+    }
+    {
+        auto & worker = *m_workers[index];
+        std::scoped_lock l_(worker.mutex);
+        worker.queue.emplace_back(std::move(fn));
+    }
+    ++m_submitted;
+    {
+        // Taken so a worker can't check m_pending and then miss the notify.
+        std::scoped_lock l_(m_sleep_mutex);
+        ++m_pending;
+    }
+    m_sleep.notify_one();
+}
+
+bool covent::OffloadPool::take(std::size_t index, std::function<void()> & fn) {
+    {
+        auto & mine = *m_workers[index];
+        std::scoped_lock l_(mine.mutex);
+        if (!mine.queue.empty()) {
+            fn = std::move(mine.queue.back());
+            mine.queue.pop_back();
+            return true;
+        }
+    }
+    for (std::size_t i = 1; i != m_workers.size(); ++i) {
+        auto & victim = *m_workers[(index + i) % m_workers.size()];
+        std::scoped_lock l_(victim.mutex);
+        if (!victim.queue.empty()) {
+            fn = std::move(victim.queue.front());
+            victim.queue.pop_front();
+            ++m_workers[index]->stolen;
+            return true;
+        }
+    }
+    return false;
+}
+
+void covent::OffloadPool::run(std::size_t index) {
+    s_pool = this;
+    s_worker = index;
+    auto & worker = *m_workers[index];
+    std::function<void()> fn;
+    for (;;) {
+        if (take(index, fn)) {
+            --m_pending;
+            fn();
+            fn = nullptr;
+            ++worker.executed;
+            continue;
+        }
+        std::unique_lock l_(m_sleep_mutex);
+        m_sleep.wait(l_, [this]() { return m_stop || m_pending > 0; });
+        if (m_stop && m_pending == 0) return;
+    }
+}
+
+covent::OffloadPool::Metrics covent::OffloadPool::metrics() const {
+    Metrics metrics;
+    metrics.submitted = m_submitted;
+    for (auto const & worker : m_workers) {
+        std::scoped_lock l_(worker->mutex);
+        metrics.workers.push_back({worker->executed, worker->stolen, worker->queue.size()});
+    }
+    return metrics;
+}
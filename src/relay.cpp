@@ -0,0 +1,276 @@
+//
+// Created by dwd on 10/17/26.
+//
+
+#include <covent/relay.h>
+#include <covent/exceptions.h>
+#include <event2/buffer.h>
+#include <event2/bufferevent.h>
+#include <event2/bufferevent_ssl.h>
+#include <event2/event.h>
+#include <openssl/ssl.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+namespace {
+    bool would_block(int err) {
+        return err == EAGAIN || err == EWOULDBLOCK || err == EINTR;
+    }
+}
+
+covent::detail::Relay::Relay(Session & a, Session & b, RelayOptions const & options)
+    : m_loop(a.loop()), m_options(options), m_directions{Direction{this, &a, &b, &m_stats.a_to_b}, Direction{this, &b, &a, &m_stats.b_to_a}} {
+    if (&a == &b) throw covent_logic_error("Can't relay a session to itself");
+    for (auto * s : {&a, &b}) {
+        if (!s->m_top) throw covent_logic_error("Can only relay connected sessions");
+        if (&s->loop() != &m_loop) throw covent_logic_error("Relayed sessions must share a Loop");
+        if (s->m_relay) throw covent_logic_error("Session is already relaying");
+        if (s->m_reader.has_value() || (s->m_processor.has_value() && !s->m_processor->done())
+            || !s->m_flushes.empty() || !s->m_write_ready_waiting.empty()) {
+            throw covent_logic_error("Can't relay a session something else is using");
+        }
+    }
+#ifdef SPLICE_F_MOVE
+    m_stats.spliced = m_options.splice && !a.ssl() && !b.ssl() && bufferevent_getfd(a.m_top) >= 0 && bufferevent_getfd(b.m_top) >= 0;
+    if (m_stats.spliced) {
+        for (auto & d : m_directions) {
+            if (::pipe2(d.pipe, O_NONBLOCK | O_CLOEXEC) != 0) {
+                auto error = std::strerror(errno);
+                stop();
+                throw covent_runtime_error(error);
+            }
+            ::fcntl(d.pipe[1], F_SETPIPE_SZ, static_cast<int>(m_options.buffer)); // Best effort; the limit may be lower.
+            m_capacity = static_cast<std::size_t>(::fcntl(d.pipe[1], F_GETPIPE_SZ));
+            d.read_event = event_new(m_loop.event_base(), bufferevent_getfd(d.from->m_top), EV_READ, splice_cb, &d);
+            d.write_event = event_new(m_loop.event_base(), bufferevent_getfd(d.to->m_top), EV_WRITE, splice_cb, &d);
+        }
+    }
+#endif
+    for (auto & d : m_directions) {
+        d.eof = d.from->m_eof;
+        d.from->m_relay = this;
+        // Whatever's been read already goes first. When splicing, the socket's ours from now on, and the
+        // bufferevent just finishes sending what it has.
+        auto * input = bufferevent_get_input(d.from->m_top);
+        *d.count += evbuffer_get_length(input);
+        evbuffer_add_buffer(bufferevent_get_output(d.to->m_top), input);
+        if (m_stats.spliced) d.from->pause_reading(Session::pause_relay);
+    }
+}
+
+covent::detail::Relay::~Relay() {
+    m_resolve.cancel();
+    if (!m_finished) stop();
+    for (auto & d : m_directions) {
+        if (d.flushing) evbuffer_remove_cb_entry(d.lower, std::exchange(d.flushing, nullptr));
+        if (d.from->m_relay == this) d.from->m_relay = nullptr;
+    }
+}
+
+covent::future<covent::RelayStats> & covent::detail::Relay::run() {
+    for (auto & d : m_directions) {
+        if (m_finished) break;
+        pump(d);
+    }
+    return m_done;
+}
+
+covent::detail::Relay::Direction & covent::detail::Relay::from(Session & session) {
+    return m_directions[0].from == &session ? m_directions[0] : m_directions[1];
+}
+
+covent::detail::Relay::Direction & covent::detail::Relay::to(Session & session) {
+    return m_directions[0].to == &session ? m_directions[0] : m_directions[1];
+}
+
+void covent::detail::Relay::readable(Session & session) {
+    if (!m_finished) pump(from(session));
+}
+
+void covent::detail::Relay::drained(Session & session) {
+    if (!m_finished) pump(to(session));
+}
+
+void covent::detail::Relay::ended(Session & session, short flags) {
+    if (m_finished) {
+        resolve(); // Whatever's still to flush isn't going anywhere.
+        return;
+    }
+    if (flags & (BEV_EVENT_ERROR | BEV_EVENT_TIMEOUT)) {
+        finish(true);
+        return;
+    }
+    auto & d = from(session);
+    d.eof = true;
+    pump(d);
+}
+
+void covent::detail::Relay::detached(Session &) {
+    if (m_finished) {
+        resolve();
+    } else {
+        finish(true);
+    }
+}
+
+void covent::detail::Relay::splice_cb(evutil_socket_t, short, void * arg) {
+    auto & d = *static_cast<Direction *>(arg);
+    if (!d.relay->m_finished) d.relay->pump_splice(d);
+}
+
+void covent::detail::Relay::flushed_cb(struct evbuffer * buffer, struct evbuffer_cb_info const *, void * arg) {
+    auto & d = *static_cast<Direction *>(arg);
+    if (evbuffer_get_length(buffer) || !d.flushing) return;
+    evbuffer_remove_cb_entry(d.lower, std::exchange(d.flushing, nullptr));
+    auto & directions = d.relay->m_directions;
+    if (!directions[0].flushing && !directions[1].flushing) d.relay->resolve();
+}
+
+void covent::detail::Relay::pump(Direction & d) {
+    if (m_stats.spliced) {
+        pump_splice(d);
+    } else {
+        pump_buffers(d);
+    }
+}
+
+// Move whole chains from one session's input to the other's output, up to the cap; once the output's full, stop
+// reading until it drains.
+void covent::detail::Relay::pump_buffers(Direction & d) {
+    auto * input = bufferevent_get_input(d.from->m_top);
+    auto * output = bufferevent_get_output(d.to->m_top);
+    auto queued = evbuffer_get_length(output);
+    if (queued < m_options.buffer) {
+        auto moved = evbuffer_remove_buffer(input, output, m_options.buffer - queued);
+        if (moved > 0) *d.count += static_cast<std::uint64_t>(moved);
+    }
+    if (evbuffer_get_length(input)) {
+        d.from->pause_reading(Session::pause_relay);
+    } else {
+        d.from->resume_reading(Session::pause_relay);
+    }
+    half_close(d);
+}
+
+// Socket to pipe, pipe to socket, until one of them would block. Nothing goes out until whatever the session
+// already had queued has gone, so the order's kept.
+void covent::detail::Relay::pump_splice(Direction & d) {
+#ifdef SPLICE_F_MOVE
+    auto const in = bufferevent_getfd(d.from->m_top);
+    auto const out = bufferevent_getfd(d.to->m_top);
+    auto const clear = evbuffer_get_length(bufferevent_get_output(d.to->m_top)) == 0;
+    bool wait_read;
+    bool wait_write;
+    for (bool progress = true; progress;) {
+        progress = wait_read = wait_write = false;
+        if (!d.eof && d.pending < m_capacity) {
+            auto n = ::splice(in, nullptr, d.pipe[1], nullptr, m_capacity - d.pending, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (n > 0) {
+                d.pending += static_cast<std::size_t>(n);
+                d.from->mark_active();
+                progress = true;
+            } else if (n == 0) {
+                d.eof = true;
+                progress = true;
+            } else if (would_block(errno)) {
+                // A pipe can fill up, page by page, before it's reached its size in octets; only wait on
+                // the socket if the pipe's empty, else on draining it.
+                wait_read = d.pending == 0;
+            } else {
+                finish(true);
+                return;
+            }
+        }
+        if (d.pending && clear) {
+            auto n = ::splice(d.pipe[0], nullptr, out, nullptr, d.pending, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (n > 0) {
+                d.pending -= static_cast<std::size_t>(n);
+                *d.count += static_cast<std::uint64_t>(n);
+                d.to->mark_active();
+                progress = true;
+            } else if (n < 0 && would_block(errno)) {
+                wait_write = true;
+            } else {
+                finish(true);
+                return;
+            }
+        }
+    }
+    if (wait_read) event_add(d.read_event, nullptr);
+    if (wait_write) event_add(d.write_event, nullptr);
+    half_close(d);
+#endif
+}
+
+// Pass on the end of one direction, once everything before it has gone.
+void covent::detail::Relay::half_close(Direction & d) {
+    if (d.shut || !d.eof || d.pending) return;
+    if (evbuffer_get_length(bufferevent_get_input(d.from->m_top)) || evbuffer_get_length(bufferevent_get_output(d.to->m_top))) return;
+    d.shut = true;
+    if (auto * ssl = bufferevent_openssl_get_ssl(d.to->m_top); ssl) {
+        SSL_shutdown(ssl); // Just our close_notify; we'll carry on reading.
+    } else {
+        ::shutdown(bufferevent_getfd(d.to->m_top), SHUT_WR);
+    }
+    if (m_directions[0].shut && m_directions[1].shut) finish(false);
+}
+
+// A close_notify sits below the TLS layer, where closing the session would throw it away; so wait for those to
+// have gone before handing back.
+void covent::detail::Relay::finish(bool aborted) {
+    stop();
+    m_stats.aborted = aborted;
+    bool waiting = false;
+    for (auto & d : m_directions) {
+        if (aborted || !d.to->ssl()) continue;
+        auto * lower = bufferevent_get_underlying(d.to->m_top);
+        if (!lower || !evbuffer_get_length(bufferevent_get_output(lower))) continue;
+        d.lower = bufferevent_get_output(lower);
+        d.flushing = evbuffer_add_cb(d.lower, flushed_cb, &d);
+        waiting = true;
+    }
+    if (!waiting) resolve();
+}
+
+// Hand the result back on a fresh stack: we may well be inside one of the sessions' callbacks.
+void covent::detail::Relay::resolve() {
+    for (auto & d : m_directions) {
+        if (d.flushing) evbuffer_remove_cb_entry(d.lower, std::exchange(d.flushing, nullptr));
+        if (d.from->m_relay == this) d.from->m_relay = nullptr;
+    }
+    if (m_resolve.pending()) return;
+    m_resolve = m_loop.defer([this]() {
+        m_done.resolve(m_stats);
+    });
+}
+
+// The sessions stay paused, and hooked until resolve(); relay() closes them.
+void covent::detail::Relay::stop() {
+    m_finished = true;
+    for (auto & d : m_directions) {
+        if (d.read_event) event_free(std::exchange(d.read_event, nullptr));
+        if (d.write_event) event_free(std::exchange(d.write_event, nullptr));
+        for (auto & fd : d.pipe) {
+            if (fd >= 0) ::close(std::exchange(fd, -1));
+        }
+        if (d.from->m_relay == this) d.from->pause_reading(Session::pause_relay);
+    }
+}
+
+covent::task<covent::RelayStats> covent::relay(Session & a, Session & b, RelayOptions options) {
+    // Both have to stay around until we're done with them, whatever else happens meanwhile.
+    auto keep_a = a.loop().session(a.id());
+    auto keep_b = b.loop().session(b.id());
+    RelayStats stats;
+    {
+        detail::Relay relay(a, b, options);
+        stats = co_await relay.run();
+    }
+    a.close();
+    b.close();
+    co_return stats;
+}
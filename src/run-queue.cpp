@@ -0,0 +1,53 @@
+//
+// Created by dwd on 10/17/26.
+//
+
+#include <covent/run-queue.h>
+
+using namespace covent::detail;
+
+RunQueue::RunQueue() : m_head(&m_stub), m_tail(&m_stub) {}
+
+RunQueue::~RunQueue() {
+    std::function<void()> fn;
+    while (pop(fn)) {
+        // Discard anything never run.
+    }
+}
+
+void RunQueue::push(std::function<void()> && fn) {
+    auto * node = new Node;
+    node->fn = std::move(fn);
+    auto * prev = m_head.exchange(node);
+    prev->next.store(node);
+}
+
+bool RunQueue::empty() const {
+    return m_tail == &m_stub && m_stub.next.load() == nullptr;
+}
+
+bool RunQueue::pop(std::function<void()> & fn) {
+    auto * tail = m_tail;
+    auto * next = tail->next.load();
+    if (tail == &m_stub) {
+        if (!next) return false;
+        m_tail = next;
+        tail = next;
+        next = next->next.load();
+    }
+    if (!next) {
+        if (tail != m_head.load()) {
+            return false; // A producer is mid-push; it'll be visible shortly.
+        }
+        // Tail is the last real node; put the stub behind it so we can take it.
+        m_stub.next.store(nullptr);
+        auto * prev = m_head.exchange(&m_stub);
+        prev->next.store(&m_stub);
+        next = tail->next.load();
+        if (!next) return false;
+    }
+    m_tail = next;
+    fn = std::move(tail->fn);
+    delete tail;
+    return true;
+}
@@ -62,6 +62,9 @@ std::shared_ptr<span> span::start_child(const std::string &op_name, const std::s
 }
 
 std::shared_ptr<span> span::start(const std::string & op_name, const std::string & desc) {
+#ifdef COVENT_NO_SPAN_TRACKING
+    return {};
+#else
     auto stack = detail::Stack::thread_stack.lock();
     std::shared_ptr<span> new_span;
     if (stack) {
@@ -82,15 +85,33 @@ std::shared_ptr<span> span::start(const std::string & op_name, const std::string
         }
     }
     return new_span;
+#endif
 }
 
 std::shared_ptr<transaction> transaction::start(const std::string & op_name, const std::string & desc, std::optional<std::string> const & trace_header ) {
     auto trans = std::make_shared<transaction>(op_name, desc);
+#ifndef COVENT_NO_SPAN_TRACKING
     auto stack = detail::Stack::thread_stack.lock();
     if (stack) stack->transaction = trans;
+#endif
     return trans;
 }
 
+void covent::sentry::set_tracking(tracking mode, unsigned sample_every) {
+#ifndef COVENT_NO_SPAN_TRACKING
+    detail::Stack::sample_every = sample_every ? sample_every : 1;
+    detail::Stack::mode = mode;
+#endif
+}
+
+tracking covent::sentry::get_tracking() {
+#ifdef COVENT_NO_SPAN_TRACKING
+    return tracking::off;
+#else
+    return detail::Stack::mode;
+#endif
+}
+
 span::span(sentry_span_t *s, std::shared_ptr<sentry::transaction> t) : m_span(s), m_trans(t) {}
 span::span(sentry_span_t *s, std::shared_ptr<sentry::span> const & parent, std::shared_ptr<sentry::transaction> t) : m_span(s), m_parent(parent), m_trans(t) {
 }
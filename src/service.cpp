@@ -266,3 +266,30 @@ generator_async<ConnectInfo> Service::Entry::xmpp_lookup(std::string const domai
         }
     }
 }
+
+task<std::optional<ConnectInfo>> Service::Entry::xmpp_connect(Session & session, std::string const domain, ConnectPolicy const policy) const {
+    auto targets = xmpp_lookup(domain);
+    std::vector<ConnectInfo> group; // Every address of one SRV target.
+    std::vector<struct sockaddr_storage> addresses;
+    auto it = co_await targets.begin();
+    for (;;) {
+        bool const end = !(it != targets.end());
+        std::optional<ConnectInfo> next;
+        if (!end) next = *it;
+        if (!group.empty() && (end || next->hostname != group.front().hostname || next->port != group.front().port || next->method != group.front().method)) {
+            addresses.clear();
+            for (auto const & info : group) addresses.push_back(info.sockaddr);
+            try {
+                auto index = co_await session.connect_any(addresses, policy);
+                co_return group[index];
+            } catch (std::runtime_error & e) {
+                m_logger->info("Couldn't connect to {}:{}: {}", group.front().hostname, group.front().port, e.what());
+            }
+            group.clear();
+        }
+        if (end) break;
+        group.push_back(*next);
+        co_await ++it;
+    }
+    co_return std::nullopt;
+}
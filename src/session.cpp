@@ -11,9 +11,16 @@
 #include <covent/http.h>
 #include <event2/bufferevent_ssl.h>
 #include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <covent/future.h>
+#include <covent/relay.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace{
-    covent::Session::id_type next_id = 0;
     void bev_read_cb(bufferevent * bev, void * arg) {
         auto * session = static_cast<covent::Session *>(arg);
         session->read_cb(bev);
@@ -28,55 +35,664 @@ namespace{
     }
 }
 
-covent::Session::Session(Loop & loop): m_id(next_id++), m_loop(loop) {
+covent::Session::Session(Loop & loop): m_id(loop.reserve_session_id()), m_loop(&loop) {
     m_log = Application::application().logger("Session");
 }
 
-covent::Session::Session(covent::Loop &loop, int sock, ListenerBase &): m_id(next_id++), m_loop(loop) {
+covent::Session::Session(covent::Loop &loop, int sock, ListenerBase & listener): m_id(loop.reserve_session_id()), m_loop(&loop), m_listener_sessions(listener.m_sessions) {
+    ++*m_listener_sessions;
     m_log = Application::application().logger("Session");
-    m_top = bufferevent_socket_new(m_loop.event_base(), sock, BEV_OPT_CLOSE_ON_FREE);
+    m_top = bufferevent_socket_new(m_loop->event_base(), sock, BEV_OPT_CLOSE_ON_FREE);
     bufferevent_setcb(m_top, bev_read_cb, bev_write_cb, bev_event_cb, this);
     bufferevent_enable(m_top, EV_READ | EV_WRITE);
+    watch_buffers();
+    timeouts(listener.timeouts());
 }
 
 covent::Session::~Session() {
+    if (m_relay) std::exchange(m_relay, nullptr)->detached(*this);
+    if (m_read_paused & pause_budget) m_loop->unpause(m_id);
     if (m_top) {
+        unwatch_buffers();
         bufferevent_flush(m_top, EV_WRITE, BEV_FINISHED);
         bufferevent_free(m_top);
     }
+    m_loop->release_session_id(m_id);
+    if (m_listener_sessions) --*m_listener_sessions;
 }
 
-covent::task<void> covent::Session::connect(const struct sockaddr * addr, size_t addrlen) {
+covent::task<void> covent::Session::connect(const struct sockaddr * addr, size_t addrlen, SocketOptions const & options) {
     if (m_top) throw covent_logic_error("Already connected?");
-    m_top = bufferevent_socket_new(m_loop.event_base(), -1, BEV_OPT_CLOSE_ON_FREE);
+    // Our own socket, so the options are in place before the SYN goes out.
+    auto sock = ::socket(addr->sa_family, SOCK_STREAM, 0);
+    if (sock < 0) throw covent_runtime_error(std::strerror(errno));
+    evutil_make_socket_nonblocking(sock);
+    evutil_make_socket_closeonexec(sock);
+    try {
+        apply(sock, options, false);
+    } catch (...) {
+        evutil_closesocket(sock);
+        throw;
+    }
+    m_top = bufferevent_socket_new(m_loop->event_base(), sock, BEV_OPT_CLOSE_ON_FREE);
+    handshaking(true);
     m_log->info("Connecting to [{}]:{}", address_tostring(addr), address_toport(addr));
     bufferevent_setcb(m_top, bev_read_cb, bev_write_cb, bev_event_cb, this);
+    watch_buffers();
+    if (m_need_octets || m_input_cap) update_read_watermark();
     if (0 > bufferevent_socket_connect(m_top, addr, static_cast<int>(addrlen))) {
+        std::string error = std::strerror(errno);
+        unwatch_buffers();
+        bufferevent_free(m_top);
         m_top = nullptr;
-        m_log->info("Connect: {}", std::strerror(errno));
-        throw covent_runtime_error(std::strerror(errno));
+        m_log->info("Connect: {}", error);
+        throw covent_runtime_error(error);
     }
     bufferevent_enable(m_top, EV_READ | EV_WRITE);
     co_await connected;
     co_return;
 }
 
+namespace {
+    // One Happy Eyeballs race: raw nonblocking connects, each watched for writability, until one gets through.
+    class ConnectRace {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        ConnectRace(covent::Loop & loop, std::span<struct sockaddr_storage const> addresses, covent::ConnectPolicy const & policy)
+            : m_loop(loop), m_addresses(addresses), m_policy(policy) {
+            m_order = order();
+        }
+        ConnectRace(ConnectRace const &) = delete;
+        ~ConnectRace() {
+            cleanup();
+        }
+
+        covent::future<std::pair<std::size_t, evutil_socket_t>> & run() {
+            m_deadline = m_loop.defer([this]() {
+                cleanup();
+                m_done.exception(std::make_exception_ptr(covent::covent_runtime_error("Connect timed out")));
+            }, m_policy.timeout);
+            start_next();
+            return m_done;
+        }
+
+    private:
+        struct Attempt {
+            std::size_t index;
+            evutil_socket_t fd;
+            struct event * ev;
+            clock::time_point started;
+        };
+
+        struct sockaddr const * address(std::size_t index) const {
+            return covent::sockaddr_cast<AF_UNSPEC>(&m_addresses[index]);
+        }
+
+        // Alternate families, each in order of past connect time (unknowns counting as one attempt_delay),
+        // starting with the preferred family unless the other has the quickest address.
+        std::vector<std::size_t> order() const {
+            std::array<std::vector<std::pair<double, std::size_t>>, 2> families;
+            for (std::size_t i = 0; i != m_addresses.size(); ++i) {
+                auto rtt = m_loop.connect_rtt(address(i)).value_or(m_policy.attempt_delay);
+                families[m_addresses[i].ss_family == m_policy.preferred_family ? 0 : 1].emplace_back(rtt, i);
+            }
+            for (auto & family : families) std::ranges::stable_sort(family, {}, &std::pair<double, std::size_t>::first);
+            if (!families[1].empty() && (families[0].empty() || families[1].front().first < families[0].front().first)) {
+                std::swap(families[0], families[1]);
+            }
+            std::vector<std::size_t> result;
+            for (std::size_t i = 0; result.size() != m_addresses.size(); ++i) {
+                for (auto const & family : families) {
+                    if (i < family.size()) result.push_back(family[i].second);
+                }
+            }
+            return result;
+        }
+
+        void start_next() {
+            m_stagger.cancel();
+            while (m_next != m_order.size()) {
+                auto index = m_order[m_next++];
+                auto const * addr = address(index);
+                auto len = covent::sockaddr_len(addr);
+                auto fd = ::socket(addr->sa_family, SOCK_STREAM, 0);
+                if (fd < 0) {
+                    m_error = std::strerror(errno);
+                    continue;
+                }
+                evutil_make_socket_nonblocking(fd);
+                evutil_make_socket_closeonexec(fd);
+                try {
+                    apply(fd, m_policy.options, false);
+                } catch (std::exception & e) {
+                    m_error = e.what();
+                    evutil_closesocket(fd);
+                    continue;
+                }
+                auto started = clock::now();
+                if (::connect(fd, addr, static_cast<socklen_t>(len)) == 0) {
+                    win({index, fd, nullptr, started});
+                    return;
+                }
+                if (errno != EINPROGRESS) {
+                    m_error = std::strerror(errno);
+                    m_loop.connect_rtt(addr, m_policy.timeout);
+                    evutil_closesocket(fd);
+                    continue;
+                }
+                auto & attempt = m_attempts.emplace_back(Attempt{index, fd, nullptr, started});
+                attempt.ev = event_new(m_loop.event_base(), fd, EV_WRITE, writable, this);
+                event_add(attempt.ev, nullptr);
+                if (m_next != m_order.size()) m_stagger = m_loop.defer([this]() { start_next(); }, m_policy.attempt_delay);
+                return;
+            }
+            if (m_attempts.empty()) {
+                cleanup();
+                m_done.exception(std::make_exception_ptr(covent::covent_runtime_error("Couldn't connect: " + m_error)));
+            }
+        }
+
+        static void writable(evutil_socket_t fd, short, void * arg) {
+            auto * race = static_cast<ConnectRace *>(arg);
+            auto it = std::ranges::find(race->m_attempts, fd, &Attempt::fd);
+            auto attempt = *it;
+            race->m_attempts.erase(it);
+            event_free(attempt.ev);
+            attempt.ev = nullptr;
+            int err = 0;
+            socklen_t len = sizeof(err);
+            if (::getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) != 0) err = errno;
+            if (!err) {
+                race->win(attempt);
+                return;
+            }
+            race->m_error = std::strerror(err);
+            race->m_loop.connect_rtt(race->address(attempt.index), race->m_policy.timeout);
+            evutil_closesocket(fd);
+            race->start_next(); // Don't wait for the stagger.
+        }
+
+        void win(Attempt const & winner) {
+            auto now = clock::now();
+            m_loop.connect_rtt(address(winner.index), std::chrono::duration<double>(now - winner.started).count());
+            for (auto const & loser : m_attempts) {
+                m_loop.connect_rtt(address(loser.index), std::chrono::duration<double>(now - loser.started).count(), true);
+            }
+            cleanup();
+            m_done.resolve(winner.index, winner.fd);
+        }
+
+        void cleanup() {
+            m_stagger.cancel();
+            m_deadline.cancel();
+            for (auto const & attempt : m_attempts) {
+                event_free(attempt.ev);
+                evutil_closesocket(attempt.fd);
+            }
+            m_attempts.clear();
+        }
+
+        covent::Loop & m_loop;
+        std::span<struct sockaddr_storage const> m_addresses;
+        covent::ConnectPolicy const & m_policy;
+        std::vector<std::size_t> m_order;
+        std::size_t m_next = 0;
+        std::vector<Attempt> m_attempts;
+        covent::TimerHandle m_stagger;
+        covent::TimerHandle m_deadline;
+        std::string m_error = "No addresses";
+        covent::future<std::pair<std::size_t, evutil_socket_t>> m_done;
+    };
+}
+
+covent::task<std::size_t> covent::Session::connect_any(std::span<struct sockaddr_storage const> addresses, ConnectPolicy policy) {
+    if (m_top) throw covent_logic_error("Already connected?");
+    ConnectRace race(*m_loop, addresses, policy);
+    auto [index, sock] = co_await race.run();
+    auto const * addr = sockaddr_cast<AF_UNSPEC>(&addresses[index]);
+    m_log->info("Connected to [{}]:{}", address_tostring(addr), address_toport(addr));
+    m_top = bufferevent_socket_new(m_loop->event_base(), sock, BEV_OPT_CLOSE_ON_FREE);
+    bufferevent_setcb(m_top, bev_read_cb, bev_write_cb, bev_event_cb, this);
+    watch_buffers();
+    if (m_need_octets || m_input_cap) update_read_watermark();
+    bufferevent_enable(m_top, EV_READ | EV_WRITE);
+    co_return index;
+}
+
 void covent::Session::write(std::string_view data) {
     auto buf = bufferevent_get_output(m_top);
     evbuffer_add(buf, data.data(), data.length());
 }
 
+void covent::Session::write(std::span<std::string_view const> data) {
+    auto buf = bufferevent_get_output(m_top);
+    std::array<evbuffer_iovec, 16> iovecs; // NOLINT
+    while (!data.empty()) {
+        auto n = std::min(data.size(), iovecs.size());
+        for (std::size_t i = 0; i != n; ++i) {
+            iovecs[i].iov_base = const_cast<char *>(data[i].data());
+            iovecs[i].iov_len = data[i].size();
+        }
+        evbuffer_add_iovec(buf, iovecs.data(), static_cast<int>(n));
+        data = data.subspan(n);
+    }
+}
+
+void covent::Session::write(std::string_view data, std::shared_ptr<void const> owner) {
+    auto buf = bufferevent_get_output(m_top);
+    auto * holder = new std::shared_ptr<void const>(std::move(owner));
+    auto release = [](void const *, size_t, void * arg) {
+        delete static_cast<std::shared_ptr<void const> *>(arg);
+    };
+    if (evbuffer_add_reference(buf, data.data(), data.size(), release, holder) != 0) {
+        delete holder;
+        throw covent_runtime_error("Couldn't add reference to output");
+    }
+}
+
+void covent::Session::write(struct evbuffer * data) {
+    evbuffer_add_buffer(bufferevent_get_output(m_top), data);
+}
+
+void covent::Session::write_file(int fd, ev_off_t offset, ev_off_t length) {
+    if (length < 0) {
+        // libevent would take the whole file's size here, regardless of offset.
+        struct stat st;
+        if (::fstat(fd, &st) != 0) throw covent_runtime_error(std::strerror(errno));
+        length = st.st_size - offset;
+    }
+    if (length <= 0) return;
+    auto own = ::dup(fd);
+    if (own < 0) throw covent_runtime_error(std::strerror(errno));
+    // Any flags beyond closing the fd would only disable something; libevent picks sendfile when
+    // the output drains straight to a socket, and maps the file otherwise.
+    auto * segment = evbuffer_file_segment_new(own, offset, length, EVBUF_FS_CLOSE_ON_FREE);
+    if (!segment) {
+        ::close(own);
+        throw covent_runtime_error("Couldn't open file segment");
+    }
+    auto rc = evbuffer_add_file_segment(bufferevent_get_output(m_top), segment, 0, -1);
+    evbuffer_file_segment_free(segment); // The output holds its own reference.
+    if (rc != 0) throw covent_runtime_error("Couldn't add file segment to output");
+}
+
+void covent::Session::timeouts(Timeouts const & t) {
+    m_timeouts = t;
+    m_loop->reap_sync();
+    m_start_tick = m_active_tick = m_handshake_tick = m_loop->m_reap_tick;
+    update_reap();
+}
+
+void covent::Session::mark_active() {
+    m_active_tick = m_loop->m_reap_tick;
+}
+
+void covent::Session::handshaking(bool on) {
+    m_handshaking = on;
+    m_loop->reap_sync();
+    m_handshake_tick = m_loop->m_reap_tick;
+    if (on) update_reap();
+}
+
+std::optional<std::pair<std::uint64_t, covent::Timeout>> covent::Session::next_timeout() const {
+    std::optional<std::pair<std::uint64_t, Timeout>> next;
+    auto consider = [this, &next](double seconds, std::uint64_t from, Timeout reason) {
+        if (seconds <= 0) return;
+        auto at = from + m_loop->reap_ticks(seconds);
+        if (!next || at < next->first) next.emplace(at, reason);
+    };
+    consider(m_timeouts.lifetime, m_start_tick, Timeout::lifetime);
+    if (m_handshaking) consider(m_timeouts.handshake, m_handshake_tick, Timeout::handshake);
+    consider(m_timeouts.idle, m_active_tick, Timeout::idle);
+    return next;
+}
+
+// Only ever brings our slot in the reaper forward; if the deadline's moved back, we'll find out when we're checked.
+void covent::Session::update_reap() {
+    auto next = next_timeout();
+    if (!next) return;
+    auto at = std::max(next->first, m_loop->m_reap_tick + 1);
+    if (m_reap_at && m_reap_at <= at) return;
+    if (m_reap_at) m_loop->reap_cancel(m_id, m_reap_at);
+    m_reap_at = at;
+    m_loop->reap_schedule(m_id, at);
+}
+
+void covent::Session::reap_check(std::uint64_t tick) {
+    m_reap_at = 0;
+    auto next = next_timeout();
+    if (!next) return;
+    if (next->first > tick) {
+        update_reap();
+        return;
+    }
+    switch (next->second) {
+        case Timeout::idle: ++m_loop->m_reaped.idle; break;
+        case Timeout::handshake: ++m_loop->m_reaped.handshake; break;
+        case Timeout::lifetime: ++m_loop->m_reaped.lifetime; break;
+    }
+    m_timeouts = {};
+    timed_out(next->second);
+}
+
+void covent::Session::timed_out(Timeout reason) {
+    constexpr std::array<char const *, 3> names = {"Idle", "Handshake", "Lifetime"};
+    m_log->info("{} timeout", names[static_cast<std::size_t>(reason)]);
+    if (m_top) {
+        m_write_failed = true;
+        // Thrown away rather than sent, so it mustn't count as drained: any flush still waiting on it fails.
+        auto * output = bufferevent_get_output(m_top);
+        auto drained = m_drained;
+        evbuffer_drain(output, evbuffer_get_length(output));
+        m_drained = drained;
+        writer_wake();
+    }
+    close();
+}
+
+void covent::Session::socket_options(SocketOptions const & options) {
+    if (!m_top) throw covent_logic_error("Not connected");
+    apply(bufferevent_getfd(m_top), options, false);
+}
+
 covent::task<void> covent::Session::flush(std::string_view data) {
     if (!data.empty()) write(data);
     bufferevent_flush(m_top, EV_WRITE, BEV_FLUSH);
-    co_await written;
-    co_return;
+    co_await write_awaiter{*this, m_enqueued};
+}
+
+void covent::Session::output_watermark(std::size_t high) {
+    m_high_watermark = high;
+    if (!high || output_pending() <= high / 2) resume_reading(pause_output);
+    update_write_watermark();
+}
+
+void covent::Session::input_watermark(std::size_t high) {
+    m_input_cap = high;
+    if (!high) resume_reading(pause_input);
+    update_read_watermark();
+}
+
+void covent::Session::pause_reading(unsigned reason) {
+    auto was = std::exchange(m_read_paused, m_read_paused | reason);
+    if (!was && m_top) bufferevent_disable(m_top, EV_READ);
+}
+
+void covent::Session::resume_reading(unsigned reason) {
+    if (!(m_read_paused & reason)) return;
+    m_read_paused &= ~reason;
+    if (!m_read_paused && m_top) bufferevent_enable(m_top, EV_READ);
+}
+
+std::size_t covent::Session::output_pending() const {
+    if (!m_top) return 0;
+    return evbuffer_get_length(bufferevent_get_output(m_top));
+}
+
+bool covent::Session::writer_ready(write_awaiter const & awaiter) const {
+    if (m_write_failed) return true;
+    if (awaiter.watermark) return m_high_watermark == 0 || output_pending() <= m_high_watermark;
+    return m_drained >= awaiter.offset;
+}
+
+void covent::Session::writer_wait(write_awaiter const & awaiter, task_ref waiter) {
+    if (awaiter.watermark) {
+        m_write_ready_waiting.push_back(waiter);
+    } else {
+        auto it = std::ranges::upper_bound(m_flushes, awaiter.offset, {}, &decltype(m_flushes)::value_type::first);
+        m_flushes.emplace(it, awaiter.offset, waiter);
+    }
+    update_write_watermark();
+}
+
+void covent::Session::writer_resume(write_awaiter const & awaiter) const {
+    if (!m_write_failed) return;
+    if (!awaiter.watermark && m_drained >= awaiter.offset) return;
+    throw covent_runtime_error("Connection failed before output drained");
+}
+
+void covent::Session::writer_wake() {
+    if ((m_read_paused & pause_output) && output_pending() <= m_high_watermark / 2) {
+        resume_reading(pause_output);
+        update_write_watermark();
+    }
+    if (m_flushes.empty() && m_write_ready_waiting.empty()) return;
+    auto self = loop().session(id());
+    std::vector<task_ref> ready;
+    while (!m_flushes.empty() && (m_write_failed || m_drained >= m_flushes.front().first)) {
+        ready.push_back(m_flushes.front().second);
+        m_flushes.pop_front();
+    }
+    if (m_write_failed || output_pending() <= m_high_watermark / 2) {
+        ready.insert(ready.end(), m_write_ready_waiting.begin(), m_write_ready_waiting.end());
+        m_write_ready_waiting.clear();
+    }
+    update_write_watermark();
+    for (auto const & waiter : ready) {
+        if (waiter.alive()) waiter.handle().resume();
+    }
+}
+
+// libevent calls write_cb once the output is down to the low watermark, so that's kept at the level where
+// the next waiter can go: the earliest flush's end, or half the high watermark if something's waiting on that.
+void covent::Session::update_write_watermark() {
+    if (!m_top) return;
+    std::size_t low = 0;
+    if (!m_flushes.empty()) low = static_cast<std::size_t>(m_enqueued - m_flushes.front().first);
+    if (!m_write_ready_waiting.empty() || (m_read_paused & pause_output)) low = std::max(low, m_high_watermark / 2);
+    if (low == m_write_low) return;
+    m_write_low = low;
+    bufferevent_setwatermark(m_top, EV_WRITE, low, 0);
+}
+
+void covent::Session::output_cb(struct evbuffer *, struct evbuffer_cb_info const * info, void * arg) {
+    auto * session = static_cast<Session *>(arg);
+    session->m_enqueued += info->n_added;
+    session->m_drained += info->n_deleted;
+    session->buffer_change(info);
+    if (info->n_deleted) session->m_active_tick = session->m_loop->m_reap_tick;
+    if (info->n_added) {
+        if (session->m_high_watermark && session->output_pending() > session->m_high_watermark) {
+            session->pause_reading(pause_output);
+        }
+        session->update_write_watermark();
+    }
+}
+
+void covent::Session::input_cb(struct evbuffer * buf, struct evbuffer_cb_info const * info, void * arg) {
+    auto * session = static_cast<Session *>(arg);
+    session->buffer_change(info);
+    // libevent won't read past the high watermark, but while the socket stays readable it keeps calling
+    // the read callback regardless, so stop reading altogether until process() has used some.
+    if (!session->m_input_cap) return;
+    auto full = evbuffer_get_length(buf) >= std::max(session->m_input_cap, session->m_need_octets);
+    if (full) {
+        session->pause_reading(pause_input);
+    } else {
+        session->resume_reading(pause_input);
+    }
+}
+
+void covent::Session::buffer_change(struct evbuffer_cb_info const * info) {
+    m_buffered = m_buffered + info->n_added - info->n_deleted;
+    m_loop->buffered(info->n_added, info->n_deleted);
+}
+
+void covent::Session::watch_buffers() {
+    auto * input = bufferevent_get_input(m_top);
+    auto * output = bufferevent_get_output(m_top);
+    m_buffered = evbuffer_get_length(input) + evbuffer_get_length(output);
+    m_loop->buffered(m_buffered, 0);
+    m_input_cb = evbuffer_add_cb(input, input_cb, this);
+    m_output_cb = evbuffer_add_cb(output, output_cb, this);
+    update_write_watermark();
+}
+
+void covent::Session::unwatch_buffers() {
+    if (!m_output_cb) return;
+    evbuffer_remove_cb_entry(bufferevent_get_input(m_top), m_input_cb);
+    evbuffer_remove_cb_entry(bufferevent_get_output(m_top), m_output_cb);
+    m_input_cb = m_output_cb = nullptr;
+    m_loop->buffered(0, std::exchange(m_buffered, 0));
+    if (m_write_low) bufferevent_setwatermark(m_top, EV_WRITE, 0, 0);
+    m_write_low = 0;
+}
+
+void covent::Session::need_octets(std::size_t octets) {
+    m_need_octets = octets;
+    update_read_watermark();
+}
+
+// Let libevent hold off on the read callback until there's enough, and stop reading at the cap - though
+// never below what's needed.
+void covent::Session::update_read_watermark() {
+    if (!m_top) return;
+    auto high = m_input_cap ? std::max(m_input_cap, m_need_octets) : 0;
+    bufferevent_setwatermark(m_top, EV_READ, m_need_octets, high);
+}
+
+void covent::Session::need_delimiter(std::string_view delimiter) {
+    m_need_delimiter = delimiter;
+    m_delimiter_scanned = 0;
+}
+
+bool covent::Session::have_needed(std::size_t & extent) {
+    auto * buf = bufferevent_get_input(m_top);
+    extent = 0;
+    if (m_need_octets) {
+        if (evbuffer_get_length(buf) < m_need_octets) return false;
+        extent = m_need_octets;
+        need_octets(0);
+    }
+    if (!m_need_delimiter.empty()) {
+        // Only search what's arrived since last time, plus enough overlap to catch a split delimiter.
+        struct evbuffer_ptr start;
+        evbuffer_ptr_set(buf, &start, m_delimiter_scanned, EVBUFFER_PTR_SET);
+        auto found = evbuffer_search(buf, m_need_delimiter.data(), m_need_delimiter.size(), &start);
+        if (found.pos < 0) {
+            auto len = evbuffer_get_length(buf);
+            auto overlap = m_need_delimiter.size() - 1;
+            m_delimiter_scanned = len > overlap ? len - overlap : 0;
+            return false;
+        }
+        extent = std::max(extent, static_cast<std::size_t>(found.pos) + m_need_delimiter.size());
+        m_need_delimiter.clear();
+        m_delimiter_scanned = 0;
+    }
+    return true;
 }
 
 void covent::Session::used(size_t len) {
+    m_anchored = false;
+    m_delimiter_scanned = m_delimiter_scanned > len ? m_delimiter_scanned - len : 0;
     evbuffer_drain(bufferevent_get_input(m_top), len);
 }
 
+std::string_view covent::Session::contiguous(std::size_t len) {
+    auto * buf = bufferevent_get_input(m_top);
+    m_anchored = false;
+    len = std::min(len, evbuffer_get_length(buf));
+    return {reinterpret_cast<char *>(evbuffer_pullup(buf, static_cast<ssize_t>(len))), len};
+}
+
+covent::task<std::size_t> covent::Session::process(std::string_view) {
+    throw covent_logic_error("Session has no process() implementation");
+}
+
+covent::task<std::size_t> covent::Session::process_segments(segments_type data) {
+    // No scatter-aware implementation, so fall back to pulling everything up.
+    std::size_t len = 0;
+    for (auto const & segment : data) len += segment.size();
+    co_return co_await process(contiguous(len));
+}
+
+void covent::Session::start_reader(task<void> reader) {
+    if (m_reader.has_value()) throw covent_logic_error("Session already has a reader");
+    m_reader.emplace(std::move(reader));
+    m_reader->on_completed<&Session::reader_complete>(this);
+    m_reader->start();
+}
+
+bool covent::Session::reader_ready(read_awaiter const & r) {
+    m_reader_have = false;
+    // Earlier reads aren't drained straight away; so long as what's wanted is in the rest of the
+    // first chunk, it can be handed out without touching the evbuffer at all.
+    if (m_reader_consumed && m_top) {
+        auto * buf = bufferevent_get_input(m_top);
+        struct evbuffer_iovec iov;
+        if (evbuffer_peek(buf, -1, nullptr, &iov, 1) > 0) {
+            std::string_view avail{static_cast<char const *>(iov.iov_base), iov.iov_len};
+            avail.remove_prefix(std::min(m_reader_consumed, avail.size()));
+            std::size_t len = 0;
+            if (r.octets) {
+                if (avail.size() >= r.octets) len = r.octets;
+            } else if (!r.delimiter.empty()) {
+                if (auto pos = avail.find(r.delimiter); pos != std::string_view::npos) len = pos + r.delimiter.size();
+            } else {
+                len = avail.size();
+            }
+            if (len) {
+                m_reader_result = avail.substr(0, len);
+                m_reader_consumed += len;
+                m_reader_have = true;
+                return true;
+            }
+        }
+        used(std::exchange(m_reader_consumed, 0));
+    }
+    // Even before connecting, so that whatever arrives first only wakes us once it's enough.
+    if (r.octets) {
+        need_octets(r.octets);
+    } else if (!r.delimiter.empty()) {
+        need_delimiter(r.delimiter);
+    }
+    if (!m_top) return m_closing || m_eof; // Either not connected yet, or gone for good.
+    if (evbuffer_get_length(bufferevent_get_input(m_top)) > 0 && have_needed(m_reader_extent)) {
+        m_reader_have = true;
+        return true;
+    }
+    return m_eof || m_closing;
+}
+
+std::string_view covent::Session::reader_take(read_awaiter const & r) {
+    if (!std::exchange(m_reader_have, false)) {
+        // Woken at the end of the stream, not because what we wanted arrived.
+        need_octets(0);
+        m_need_delimiter.clear();
+        if (r.octets || !r.delimiter.empty()) throw covent_runtime_error("Session closed");
+        return {};
+    }
+    if (m_reader_consumed) return std::exchange(m_reader_result, {});
+    auto * buf = bufferevent_get_input(m_top);
+    std::size_t len;
+    if (r.octets) {
+        len = r.octets;
+    } else if (!r.delimiter.empty()) {
+        len = m_reader_extent;
+    } else {
+        len = evbuffer_get_contiguous_space(buf);
+    }
+    len = std::min(len, evbuffer_get_length(buf)); // Never pull up more than is there.
+    m_reader_consumed = len;
+    return {reinterpret_cast<char *>(evbuffer_pullup(buf, static_cast<ssize_t>(len))), len};
+}
+
+void covent::Session::reader_wake() {
+    if (auto waiter = std::exchange(m_reader_waiting, {}); waiter.alive()) waiter.handle().resume();
+}
+
+void covent::Session::reader_complete() {
+    auto self = loop().session(id());
+    if (m_reader_consumed && m_top) used(std::exchange(m_reader_consumed, 0));
+    try {
+        m_reader->get();
+    } catch (std::exception & e) {
+        m_log->debug("Reader exception caught: {}", e.what());
+    }
+    close();
+}
+
 void covent::Session::processing_complete() {
     auto self = loop().session(id());
     try {
@@ -94,7 +710,12 @@ void covent::Session::processing_complete() {
 }
 
 void covent::Session::read_cb(struct bufferevent *) {
+    m_active_tick = m_loop->m_reap_tick;
     auto self = loop().session(id());
+    if (m_relay) {
+        m_relay->readable(*this);
+        return;
+    }
     if (m_processor.has_value()) {
         // Wait until it's done.
         if (m_processor->done()) {
@@ -103,16 +724,95 @@ void covent::Session::read_cb(struct bufferevent *) {
             return;
         }
     }
+    if (m_reader.has_value()) {
+        if (m_reader_waiting && evbuffer_get_length(bufferevent_get_input(m_top)) > 0 && have_needed(m_reader_extent)) {
+            m_reader_have = true;
+            reader_wake();
+        }
+        return;
+    }
+    if (m_scatter) {
+        read_scatter();
+    } else {
+        read_contiguous();
+    }
+}
+
+void covent::Session::read_scatter() {
+    m_log->trace("Scatter data mode");
+    std::size_t extent;
+    while (m_top && have_needed(extent)) {
+        if (!peek_segments()) return;
+        try {
+            m_processor.emplace(process_segments(m_segments));
+            if (!m_processor->start()) {
+                m_processor->on_completed<&Session::processing_complete>(this);
+                return;
+            }
+            auto used_octets = m_processor->get();
+            m_processor.reset();
+            m_log->trace("Immediate/scatter: used {} octets", used_octets);
+            if (!used_octets) break;
+            used(used_octets);
+        } catch (std::exception & e) {
+            m_log->debug("Immediate/scatter: exception caught: {}", e.what());
+            m_processor.reset();
+            close();
+            return;
+        }
+    }
+}
+
+bool covent::Session::peek_segments() {
+    // Until something's consumed, segments already seen stay put; only the last can have grown. So look
+    // again from the start of that one, rather than walking every chain each time more data arrives.
+    // Growing it may have moved it to a new chain, though, so all we keep is its offset: an evbuffer_ptr
+    // doesn't survive changes to the buffer.
+    auto * buf = bufferevent_get_input(m_top);
+    struct evbuffer_ptr anchor;
+    struct evbuffer_ptr * start = nullptr;
+    if (m_anchored) {
+        m_segments.pop_back();
+        evbuffer_ptr_set(buf, &anchor, m_anchor, EVBUFFER_PTR_SET);
+        start = &anchor;
+    } else {
+        m_segments.clear();
+    }
+    auto n = evbuffer_peek(buf, -1, start, nullptr, 0);
+    m_iovecs.resize(static_cast<std::size_t>(std::max(n, 0)));
+    evbuffer_peek(buf, -1, start, m_iovecs.data(), n);
+    std::size_t offset = 0;
+    std::size_t last = 0;
+    for (auto const & iov : m_iovecs) {
+        if (!iov.iov_len) continue; // Empty chains, awaiting data.
+        offset += last;
+        last = iov.iov_len;
+        m_segments.emplace_back(static_cast<char const *>(iov.iov_base), iov.iov_len);
+    }
+    if (m_segments.empty()) {
+        m_anchored = false;
+        return false;
+    }
+    m_anchor = start ? m_anchor + offset : offset;
+    m_anchored = true;
+    return true;
+}
+
+void covent::Session::read_contiguous() {
     // Create and start the process task.
     // We'll try first using whatever contiguous data we have to hand:
     size_t len;
+    std::size_t extent;
     struct evbuffer *buf = bufferevent_get_input(m_top);
     m_log->trace("Contiguous data mode");
     while ((len = evbuffer_get_contiguous_space(buf)) > 0) {
+        if (!have_needed(extent)) return;
+        // If what the processor's waiting for runs past the first chunk, don't bother with it.
+        if (extent > len) break;
         try {
             m_processor.emplace(process({reinterpret_cast<char *>(evbuffer_pullup(buf, static_cast<ssize_t>(len))), len}));
             if (!m_processor->start()) {
-                m_processor->on_completed(this, &Session::processing_complete);
+                m_processor->on_completed<&Session::processing_complete>(this);
                 return;
             }
             auto used_octets = m_processor->get();
@@ -138,11 +838,11 @@ void covent::Session::read_cb(struct bufferevent *) {
         return;
     }
     m_log->trace("All data mode");
-    while ((len = evbuffer_get_length(buf)) > 0) {
+    while (have_needed(extent) && (len = evbuffer_get_length(buf)) > 0) {
         try {
             m_processor.emplace(process({reinterpret_cast<char *>(evbuffer_pullup(buf, -1)), len}));
             if (!m_processor->start()) {
-                m_processor->on_completed(this, &Session::processing_complete);
+                m_processor->on_completed<&Session::processing_complete>(this);
                 return;
             }
             auto used_octets = m_processor->get();
@@ -163,11 +863,14 @@ void covent::Session::read_cb(struct bufferevent *) {
 }
 
 void covent::Session::write_cb(struct bufferevent *) {
-    this->written.emit();
+    writer_wake();
+    if (m_relay) {
+        m_relay->drained(*this);
+        return;
+    }
     if (m_closing) {
         close();
     }
-    // Not actually sure!
 }
 
 void covent::Session::event_cb(struct bufferevent * buf, short flags) {
@@ -176,8 +879,19 @@ void covent::Session::event_cb(struct bufferevent * buf, short flags) {
     }
     if (flags & BEV_EVENT_CONNECTED) {
         m_log->debug("Connected");
+        handshaking(false);
         this->connected.emit();
     }
+    if (m_relay && (flags & (BEV_EVENT_EOF | BEV_EVENT_ERROR | BEV_EVENT_TIMEOUT))) {
+        m_relay->ended(*this, flags);
+        return;
+    }
+    if (flags & (BEV_EVENT_EOF | BEV_EVENT_ERROR)) {
+        m_eof = true;
+    }
+    if (flags & BEV_EVENT_ERROR) {
+        m_write_failed = true;
+    }
     if (flags & BEV_EVENT_EOF) {
         m_log->debug("Disconnected");
         this->closed();
@@ -196,6 +910,8 @@ void covent::Session::event_cb(struct bufferevent * buf, short flags) {
         this->closed();
     }
     // Process flags (close, etc).
+    if (m_eof) reader_wake(); // If closed() hasn't already.
+    if (m_write_failed) writer_wake();
 }
 
 SSL * covent::Session::ssl() const {
@@ -203,36 +919,148 @@ SSL * covent::Session::ssl() const {
 }
 
 sigslot::signal<> & covent::Session::ssl(SSL *s, bool connecting) {
+    m_anchored = false;
+    if (m_need_octets || m_input_cap) bufferevent_setwatermark(m_top, EV_READ, 0, 0); // The filter needs every octet.
+    // Whatever's still queued below is now the filter's business; count it as gone.
+    m_drained += evbuffer_get_length(bufferevent_get_output(m_top));
+    unwatch_buffers();
     m_top = bufferevent_openssl_filter_new(bufferevent_get_base(m_top), m_top, s, connecting ? BUFFEREVENT_SSL_CONNECTING : BUFFEREVENT_SSL_ACCEPTING, BEV_OPT_CLOSE_ON_FREE);
     bufferevent_setcb(m_top, bev_read_cb, bev_write_cb, bev_event_cb, this);
-    bufferevent_enable(m_top, EV_READ | EV_WRITE);
+    bufferevent_enable(m_top, m_read_paused ? EV_WRITE : EV_READ | EV_WRITE);
+    watch_buffers();
+    handshaking(true);
+    if (m_need_octets || m_input_cap) update_read_watermark();
     return connected;
 }
 
 void covent::Session::close() {
     m_closing = true;
+    if (m_relay) std::exchange(m_relay, nullptr)->detached(*this);
     if (m_processor.has_value() && !m_processor->done()) {
         return;
     }
+    if (m_reader.has_value() && !m_reader->done()) {
+        // Any read it's waiting on fails now; we'll be back once it's finished.
+        reader_wake();
+        return;
+    }
     if (m_top) {
         bufferevent_flush(m_top, EV_WRITE, BEV_FINISHED);
         auto * buf = bufferevent_get_output(m_top);
         if (evbuffer_get_length(buf) > 0) {
             return;
         }
+        unwatch_buffers();
         bufferevent_free(m_top);
         m_top = nullptr;
     }
-    m_loop.defer([session = this, loop = &m_loop]() {
+    m_loop->defer([session = this, loop = m_loop]() {
         loop->remove(*session);
     });
 }
 
+void covent::Session::migrate_start(Loop & target, std::function<void()> && resume) {
+    if (!m_flushes.empty() || !m_write_ready_waiting.empty() || m_reader_waiting) {
+        throw covent_logic_error("Can't migrate a session something else is waiting on");
+    }
+    if (m_handshaking) throw covent_logic_error("Can't migrate a session mid-handshake");
+    if (m_relay) throw covent_logic_error("Can't migrate a session while it's relaying");
+    auto self = m_loop->session(m_id);
+    if (!self) throw covent_logic_error("Session isn't on its loop");
+    // Whoever resumed us may well still be using the session, so let them unwind first.
+    m_loop->defer([self, target = &target, resume = std::move(resume)]() mutable {
+        self->migrate_detach(self, *target, std::move(resume));
+    });
+}
+
+// The socket and SSL are kept, the bufferevents rebuilt around them; whatever's buffered at either layer moves across.
+void covent::Session::migrate_detach(std::shared_ptr<Session> const & self, Loop & target, std::function<void()> && resume) {
+    auto & source = *m_loop;
+    // Timeouts carry on from where they were, in seconds rather than either loop's ticks.
+    auto age = [&source](std::uint64_t tick) {
+        return static_cast<double>(source.m_reap_tick - tick) * source.m_reap_resolution;
+    };
+    std::array<double, 3> ages = {age(m_start_tick), age(m_active_tick), age(m_handshake_tick)};
+    evutil_socket_t fd = -1;
+    SSL * ssl = nullptr;
+    std::array<struct evbuffer *, 4> buffers = {};
+    if (m_top) {
+        unwatch_buffers();
+        auto take = [](struct evbuffer * from) {
+            auto * buf = evbuffer_new();
+            evbuffer_add_buffer(buf, from);
+            return buf;
+        };
+        auto * under = bufferevent_get_underlying(m_top);
+        auto * sock = under ? under : m_top;
+        buffers[0] = take(bufferevent_get_input(m_top));
+        buffers[1] = take(bufferevent_get_output(m_top));
+        if (under) {
+            buffers[2] = take(bufferevent_get_input(under));
+            buffers[3] = take(bufferevent_get_output(under));
+        }
+        ssl = bufferevent_openssl_get_ssl(m_top);
+        if (ssl) SSL_up_ref(ssl); // Freeing the filter drops its reference, not ours.
+        fd = bufferevent_getfd(sock);
+        bufferevent_setcb(m_top, nullptr, nullptr, nullptr, nullptr);
+        bufferevent_disable(m_top, EV_READ | EV_WRITE);
+        bufferevent_setfd(sock, -1); // Nor does it close the socket.
+        bufferevent_free(std::exchange(m_top, nullptr));
+    }
+    if (m_read_paused & pause_budget) {
+        source.unpause(m_id);
+        m_read_paused &= ~pause_budget;
+    }
+    source.remove(*this);
+    m_reap_at = 0;
+    source.release_session_id(m_id);
+    m_loop = &target;
+    target.post([self, fd, ssl, buffers, ages, resume = std::move(resume)]() {
+        self->migrate_attach(self, fd, ssl, buffers, ages);
+        resume();
+    });
+}
+
+void covent::Session::migrate_attach(std::shared_ptr<Session> const & self, evutil_socket_t fd, SSL * ssl, std::array<struct evbuffer *, 4> buffers, std::array<double, 3> ages) {
+    m_id = m_loop->reserve_session_id();
+    if (fd >= 0) {
+        auto put = [](struct bufferevent * bev, struct evbuffer * input, struct evbuffer * output) {
+            if (!input) return;
+            evbuffer_add_buffer(bufferevent_get_input(bev), input);
+            evbuffer_add_buffer(bufferevent_get_output(bev), output);
+            evbuffer_free(input);
+            evbuffer_free(output);
+        };
+        m_top = bufferevent_socket_new(m_loop->event_base(), fd, BEV_OPT_CLOSE_ON_FREE);
+        if (ssl) {
+            put(m_top, buffers[2], buffers[3]);
+            m_top = bufferevent_openssl_filter_new(m_loop->event_base(), m_top, ssl, BUFFEREVENT_SSL_OPEN, BEV_OPT_CLOSE_ON_FREE);
+        }
+        put(m_top, buffers[0], buffers[1]);
+        bufferevent_setcb(m_top, bev_read_cb, bev_write_cb, bev_event_cb, this);
+        if (m_need_octets || m_input_cap) update_read_watermark();
+        watch_buffers();
+        bufferevent_enable(m_top, m_read_paused ? EV_WRITE : EV_READ | EV_WRITE);
+    }
+    m_loop->add(self);
+    m_loop->reap_sync();
+    auto tick = [this](double age) {
+        auto back = static_cast<std::uint64_t>(age / m_loop->m_reap_resolution);
+        return m_loop->m_reap_tick > back ? m_loop->m_reap_tick - back : 0;
+    };
+    m_start_tick = tick(ages[0]);
+    m_active_tick = tick(ages[1]);
+    m_handshake_tick = tick(ages[2]);
+    update_reap();
+}
+
 bufferevent * covent::Session::eject() {
+    unwatch_buffers();
     auto * ret = m_top;
     m_top = nullptr;
     bufferevent_setcb(ret, nullptr, nullptr, nullptr, nullptr);
+    if (m_need_octets || m_input_cap) bufferevent_setwatermark(ret, EV_READ, 0, 0);
     bufferevent_disable(ret, EV_READ|EV_WRITE);
-    m_loop.remove(*this);
+    m_loop->remove(*this);
     return ret;
 }
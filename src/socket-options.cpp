@@ -0,0 +1,94 @@
+//
+// Created by dwd on 10/17/26.
+//
+
+#include <covent/socket-options.h>
+#include <covent/exceptions.h>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+namespace {
+    void set(evutil_socket_t sock, int level, int name, int value, char const * what) {
+        if (::setsockopt(sock, level, name, &value, sizeof(value)) != 0) {
+            throw covent::covent_runtime_error(std::string("Couldn't set ") + what + ": " + std::strerror(errno));
+        }
+    }
+
+    [[noreturn, maybe_unused]] void unsupported(char const * what) {
+        throw covent::covent_runtime_error(std::string(what) + " isn't supported on this platform");
+    }
+
+    int family_of(evutil_socket_t sock) {
+        struct sockaddr_storage ss = {};
+        socklen_t len = sizeof(ss);
+        if (::getsockname(sock, reinterpret_cast<struct sockaddr *>(&ss), &len) != 0) return AF_UNSPEC;
+        return ss.ss_family;
+    }
+}
+
+void covent::apply(evutil_socket_t sock, SocketOptions const & options, bool listening) {
+    if (options.nodelay) set(sock, IPPROTO_TCP, TCP_NODELAY, *options.nodelay, "TCP_NODELAY");
+    if (options.receive_buffer) set(sock, SOL_SOCKET, SO_RCVBUF, *options.receive_buffer, "SO_RCVBUF");
+    if (options.send_buffer) set(sock, SOL_SOCKET, SO_SNDBUF, *options.send_buffer, "SO_SNDBUF");
+    bool keepalive_timers = options.keepalive_idle || options.keepalive_interval || options.keepalive_count;
+    if (options.keepalive || keepalive_timers) {
+        set(sock, SOL_SOCKET, SO_KEEPALIVE, options.keepalive.value_or(true), "SO_KEEPALIVE");
+    }
+#ifdef TCP_KEEPIDLE
+    if (options.keepalive_idle) set(sock, IPPROTO_TCP, TCP_KEEPIDLE, *options.keepalive_idle, "TCP_KEEPIDLE");
+#elif defined(TCP_KEEPALIVE)
+    if (options.keepalive_idle) set(sock, IPPROTO_TCP, TCP_KEEPALIVE, *options.keepalive_idle, "TCP_KEEPALIVE");
+#else
+    if (options.keepalive_idle) unsupported("TCP_KEEPIDLE");
+#endif
+#ifdef TCP_KEEPINTVL
+    if (options.keepalive_interval) set(sock, IPPROTO_TCP, TCP_KEEPINTVL, *options.keepalive_interval, "TCP_KEEPINTVL");
+#else
+    if (options.keepalive_interval) unsupported("TCP_KEEPINTVL");
+#endif
+#ifdef TCP_KEEPCNT
+    if (options.keepalive_count) set(sock, IPPROTO_TCP, TCP_KEEPCNT, *options.keepalive_count, "TCP_KEEPCNT");
+#else
+    if (options.keepalive_count) unsupported("TCP_KEEPCNT");
+#endif
+#ifdef TCP_USER_TIMEOUT
+    if (options.user_timeout) set(sock, IPPROTO_TCP, TCP_USER_TIMEOUT, *options.user_timeout, "TCP_USER_TIMEOUT");
+#else
+    if (options.user_timeout) unsupported("TCP_USER_TIMEOUT");
+#endif
+#ifdef SO_BUSY_POLL
+    if (options.busy_poll) set(sock, SOL_SOCKET, SO_BUSY_POLL, *options.busy_poll, "SO_BUSY_POLL");
+#else
+    if (options.busy_poll) unsupported("SO_BUSY_POLL");
+#endif
+    if (options.tos) {
+        if (family_of(sock) == AF_INET6) {
+            set(sock, IPPROTO_IPV6, IPV6_TCLASS, *options.tos, "IPV6_TCLASS");
+        } else {
+            set(sock, IPPROTO_IP, IP_TOS, *options.tos, "IP_TOS");
+        }
+    }
+    if (listening) {
+#ifdef TCP_FASTOPEN
+        if (options.fastopen) set(sock, IPPROTO_TCP, TCP_FASTOPEN, *options.fastopen, "TCP_FASTOPEN");
+#else
+        if (options.fastopen) unsupported("TCP_FASTOPEN");
+#endif
+#ifdef TCP_DEFER_ACCEPT
+        if (options.defer_accept) set(sock, IPPROTO_TCP, TCP_DEFER_ACCEPT, *options.defer_accept, "TCP_DEFER_ACCEPT");
+#else
+        if (options.defer_accept) unsupported("TCP_DEFER_ACCEPT");
+#endif
+    } else {
+#ifdef TCP_FASTOPEN_CONNECT
+        if (options.fastopen) set(sock, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, 1, "TCP_FASTOPEN_CONNECT");
+#else
+        if (options.fastopen) unsupported("TCP_FASTOPEN_CONNECT");
+#endif
+    }
+}
@@ -0,0 +1,184 @@
+//
+// Created by dwd on 10/17/26.
+//
+
+#include <covent/timer-wheel.h>
+#include <bit>
+
+using namespace covent::detail;
+
+TimerWheel::TimerWheel(clock::time_point origin) : m_origin(origin) {}
+
+std::uint64_t TimerWheel::tick_at(clock::time_point t, bool round_up) const {
+    if (t <= m_origin) return 0;
+    auto since = t - m_origin;
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(since);
+    auto tick = static_cast<std::uint64_t>(ms.count());
+    // Round deadlines up, so a timer never fires early; round "now" down for the same reason.
+    if (round_up && ms < since) ++tick;
+    return tick;
+}
+
+TimerWheel::id_type TimerWheel::add(std::function<void()> && fn, clock::duration delay, clock::time_point now) {
+    std::uint32_t index;
+    if (m_free != npos) {
+        index = m_free;
+        m_free = m_entries[index].next;
+    } else {
+        index = static_cast<std::uint32_t>(m_entries.size());
+        m_entries.emplace_back().generation = 1;
+    }
+    auto & entry = m_entries[index];
+    entry.fn = std::move(fn);
+    entry.expiry = delay.count() > 0 ? tick_at(now + delay, true) : m_now;
+    place(index);
+    ++m_size;
+    return (static_cast<id_type>(entry.generation) << 32) | index;
+}
+
+bool TimerWheel::pending(id_type id) const {
+    auto index = static_cast<std::uint32_t>(id & 0xFFFFFFFF);
+    auto generation = static_cast<std::uint32_t>(id >> 32);
+    if (index >= m_entries.size()) return false;
+    auto const & entry = m_entries[index];
+    return entry.generation == generation && entry.list != free_list;
+}
+
+bool TimerWheel::cancel(id_type id) {
+    if (!pending(id)) return false;
+    auto index = static_cast<std::uint32_t>(id & 0xFFFFFFFF);
+    unlink(index);
+    release(index);
+    --m_size;
+    return true;
+}
+
+bool TimerWheel::reschedule(id_type id, clock::duration delay, clock::time_point now) {
+    if (!pending(id)) return false;
+    auto index = static_cast<std::uint32_t>(id & 0xFFFFFFFF);
+    unlink(index);
+    m_entries[index].expiry = delay.count() > 0 ? tick_at(now + delay, true) : m_now;
+    place(index);
+    return true;
+}
+
+void TimerWheel::place(std::uint32_t index) {
+    auto expiry = m_entries[index].expiry;
+    if (expiry <= m_now) {
+        link(due_list, index);
+        return;
+    }
+    auto delta = expiry - m_now;
+    unsigned level = 0;
+    while (level < levels - 1 && delta >= (std::uint64_t{1} << (slot_bits * (level + 1)))) {
+        ++level;
+    }
+    auto slot = static_cast<unsigned>((expiry >> (slot_bits * level)) & (slots - 1));
+    link(static_cast<std::uint16_t>(level * slots + slot), index);
+}
+
+void TimerWheel::link(std::uint16_t list_id, std::uint32_t index) {
+    auto & list = list_id == due_list ? m_due : m_slots[list_id];
+    auto & entry = m_entries[index];
+    entry.list = list_id;
+    entry.next = npos;
+    entry.prev = list.tail;
+    if (list.tail != npos) {
+        m_entries[list.tail].next = index;
+    } else {
+        list.head = index;
+    }
+    list.tail = index;
+    if (list_id != due_list) {
+        m_occupied[list_id / slots] |= std::uint64_t{1} << (list_id % slots);
+    }
+}
+
+void TimerWheel::unlink(std::uint32_t index) {
+    auto & entry = m_entries[index];
+    auto & list = entry.list == due_list ? m_due : m_slots[entry.list];
+    if (entry.prev != npos) {
+        m_entries[entry.prev].next = entry.next;
+    } else {
+        list.head = entry.next;
+    }
+    if (entry.next != npos) {
+        m_entries[entry.next].prev = entry.prev;
+    } else {
+        list.tail = entry.prev;
+    }
+    if (list.head == npos && entry.list != due_list) {
+        m_occupied[entry.list / slots] &= ~(std::uint64_t{1} << (entry.list % slots));
+    }
+    entry.prev = entry.next = npos;
+}
+
+void TimerWheel::release(std::uint32_t index) {
+    auto & entry = m_entries[index];
+    entry.fn = nullptr;
+    entry.list = free_list;
+    if (++entry.generation == 0) entry.generation = 1; // Zero is never a valid id.
+    entry.next = m_free;
+    m_free = index;
+}
+
+void TimerWheel::cascade(unsigned level, unsigned slot) {
+    auto list_id = static_cast<std::uint16_t>(level * slots + slot);
+    auto index = m_slots[list_id].head;
+    m_slots[list_id] = {};
+    m_occupied[level] &= ~(std::uint64_t{1} << slot);
+    while (index != npos) {
+        auto next = m_entries[index].next;
+        place(index);
+        index = next;
+    }
+}
+
+std::optional<std::uint64_t> TimerWheel::next_tick() const {
+    if (m_due.head != npos) return m_now;
+    std::optional<std::uint64_t> result;
+    for (unsigned level = 0; level != levels; ++level) {
+        auto bits = m_occupied[level];
+        if (!bits) continue;
+        auto shift = slot_bits * level;
+        auto block = m_now >> shift;
+        auto current = static_cast<int>(block & (slots - 1));
+        // Distance, in slots of this level, to the next occupied one - a full turn if it's the current slot.
+        auto distance = std::countr_zero(std::rotr(bits, current + 1)) + 1;
+        auto tick = (block + static_cast<std::uint64_t>(distance)) << shift;
+        if (!result || tick < *result) result = tick;
+    }
+    return result;
+}
+
+void TimerWheel::expire(std::vector<std::function<void()>> & out, clock::time_point now) {
+    auto target = tick_at(now, false);
+    for (;;) {
+        while (m_due.head != npos) {
+            auto index = m_due.head;
+            out.emplace_back(std::move(m_entries[index].fn));
+            unlink(index);
+            release(index);
+            --m_size;
+        }
+        auto next = next_tick();
+        if (!next || *next > target) break;
+        m_now = *next;
+        for (unsigned level = levels - 1; level != 0; --level) {
+            auto shift = slot_bits * level;
+            if ((m_now & ((std::uint64_t{1} << shift) - 1)) == 0) {
+                cascade(level, static_cast<unsigned>((m_now >> shift) & (slots - 1)));
+            }
+        }
+        cascade(0, static_cast<unsigned>(m_now & (slots - 1)));
+    }
+    if (target > m_now) m_now = target;
+}
+
+std::optional<TimerWheel::clock::duration> TimerWheel::next_expiry(clock::time_point now) const {
+    auto next = next_tick();
+    if (!next) return {};
+    auto when = m_origin + std::chrono::milliseconds(*next);
+    if (when <= now) return clock::duration::zero();
+    return when - now;
+}
@@ -10,6 +10,7 @@
 #include <openssl/ssl.h>
 
 #include <covent/crl-cache.h>
+#include <covent/offload.h>
 
 using namespace covent::pkix;
 
@@ -48,15 +49,21 @@ covent::task<std::tuple<std::string, int, X509_CRL *>> CrlCache::do_crl(std::str
         // METRE_LOG(Log::INFO, "HTTP GET for " << uri << " returned " << status_code);
         if ((status_code / 100) == 2) {
             auto body = response->body();
-            auto body_start = reinterpret_cast<const unsigned char *>(body.data());
-            X509_CRL *data = d2i_X509_CRL(nullptr, &body_start, body.size());
+            // Big CRLs take a while to parse. OpenSSL's error queue is per-thread, so drain it there too.
+            X509_CRL *data = co_await covent::offload([body]() {
+                auto body_start = reinterpret_cast<const unsigned char *>(body.data());
+                X509_CRL *parsed = d2i_X509_CRL(nullptr, &body_start, static_cast<long>(body.size()));
+                if (!parsed) {
+                    while (unsigned long ssl_err = ERR_get_error()) {
+                        std::array<char, 1024> error_buf;
+                        // METRE_LOG(Metre::Log::DEBUG, " :: " << ERR_error_string(ssl_err, error_buf.data()));
+                    }
+                }
+                return parsed;
+            });
             if (data) {
                 co_return {uri, 200, data};
             } else {
-                while (unsigned long ssl_err = ERR_get_error()) {
-                    std::array<char, 1024> error_buf;
-                    // METRE_LOG(Metre::Log::DEBUG, " :: " << ERR_error_string(ssl_err, error_buf.data()));
-                }
                 co_return {uri, 400, nullptr};
             }
         }
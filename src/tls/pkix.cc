@@ -19,6 +19,7 @@
 
 #include "covent/covent.h"
 #include "covent/crl-cache.h"
+#include "covent/offload.h"
 
 using namespace covent::pkix;
 
@@ -262,6 +263,29 @@ EjhZjvPJOKqTisDI6g9A9ak87cfIh26eYj+vm5JOnjYltmaZ6U83AgEC
         return preverify_ok;
     }
 
+    // A store context with its own references to everything it verifies against. An offloaded verification holds
+    // one of these, so if the awaiting task is destroyed meanwhile, the worker still owns what it's using.
+    struct StoreContext {
+        X509_STORE_CTX * st = X509_STORE_CTX_new();
+        X509_STORE * store;
+        X509 * cert;
+        STACK_OF(X509) * chain;
+
+        StoreContext(X509_STORE * s, X509 * c, STACK_OF(X509) * ch) : store(s), cert(c), chain(ch ? X509_chain_up_ref(ch) : nullptr) {
+            X509_STORE_up_ref(store);
+            X509_up_ref(cert);
+        }
+        StoreContext(StoreContext const &) = delete;
+        ~StoreContext() {
+            X509_STORE_CTX_free(st);
+            sk_X509_pop_free(chain, X509_free);
+            X509_free(cert);
+            X509_STORE_free(store);
+        }
+        void init() const {
+            X509_STORE_CTX_init(st, store, cert, chain);
+        }
+    };
 }
 
 PKIXIdentity::PKIXIdentity(std::string const & cert_chain, std::string const & pkey) : m_cert_chain_file(cert_chain), m_pkey_file(pkey) {
@@ -299,16 +323,12 @@ covent::task<void> PKIXValidator::fetch_crls(const SSL *ssl, X509 *cert) {
     STACK_OF(X509) *chain = SSL_get_peer_cert_chain(ssl);
     const SSL_CTX *ctx = SSL_get_SSL_CTX(ssl);
     X509_STORE *store = SSL_CTX_get_cert_store(ctx);
-    X509_STORE_CTX *st = X509_STORE_CTX_new();
-    struct destroy_store {
-        X509_STORE_CTX * st;
-        ~destroy_store() {
-            if (st) X509_STORE_CTX_free(st);
-        }
-    } store_keeper = {st};
-    X509_STORE_CTX_init(st, store, cert, chain);
-    X509_verify_cert(st);
-    STACK_OF(X509) *verified = X509_STORE_CTX_get0_chain(st);
+    auto job = std::make_shared<StoreContext>(store, cert, chain);
+    job->init();
+    co_await covent::offload([job]() {
+        X509_verify_cert(job->st);
+    });
+    STACK_OF(X509) *verified = X509_STORE_CTX_get0_chain(job->st);
     std::set<std::string, std::less<>> all_crls;
     for (int certnum = 0; certnum != sk_X509_num(verified); ++certnum) {
         auto current_cert = sk_X509_value(verified, certnum);
@@ -387,13 +407,14 @@ covent::task<bool> PKIXValidator::verify_tls(SSL * ssl, std::string remote_domai
         m_log->debug("Adding gathered hostname {}", host);
         X509_VERIFY_PARAM_add1_host(vpm, host.c_str(), host.size());
     }
-    auto *st = X509_STORE_CTX_new();
     if (!m_trust_blobs.empty()) {
         store = free_store = X509_STORE_new();
         for (auto * ta : m_trust_blobs) {
             X509_STORE_add_cert(store, ta);
         }
     }
+    auto job = std::make_shared<StoreContext>(store, cert, chain);
+    auto *st = job->st;
     X509_STORE_CTX_set0_param(st, vpm); // Hands ownership to st.
     // Fun fact: We can only add these to SSL_DANE via the connection.
     for (auto const & rr : gathered.gathered_tlsa) {
@@ -406,11 +427,20 @@ covent::task<bool> PKIXValidator::verify_tls(SSL * ssl, std::string remote_domai
             m_log->warn("TLSA record rejected");
         }
     }
-    X509_STORE_CTX_init(st, store, cert, chain);
-    X509_STORE_CTX_set0_dane(st, SSL_get0_dane(ssl));
+    job->init();
     X509_STORE_CTX_set_verify_cb(st, reverify_callback);
     m_log->info("Reverification for {}", remote_domain);
-    bool valid = (X509_verify_cert(st) == 1);
+    bool valid;
+    if (gathered.gathered_tlsa.empty()) {
+        // Chain building and signature checks are the expensive part, so keep them off the loop.
+        valid = co_await covent::offload([job]() {
+            return X509_verify_cert(job->st) == 1;
+        });
+    } else {
+        // The DANE state belongs to the SSL, which the loop goes on using; so this one stays here.
+        X509_STORE_CTX_set0_dane(st, SSL_get0_dane(ssl));
+        valid = (X509_verify_cert(st) == 1);
+    }
     if (valid) {
         if (gathered.gathered_tlsa.empty()) {
             m_log->info("verify_tls: PKIX verification succeeded");
@@ -424,7 +454,6 @@ covent::task<bool> PKIXValidator::verify_tls(SSL * ssl, std::string remote_domai
         m_log->warn("verify_tls: Chain failed validation: {} (at depth {})", ERR_error_string(error, buf.data()),
                              depth);
     }
-    X509_STORE_CTX_free(st);
     if (free_store) X509_STORE_free(free_store);
     co_return valid;
 }
@@ -0,0 +1,128 @@
+//
+// Created by dwd on 10/17/26.
+//
+
+#include "gtest/gtest.h"
+#include <covent/covent.h>
+#include <covent/listener.h>
+#include <covent/loop.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <unistd.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace {
+    class IdleSession : public covent::Session {
+    public:
+        using covent::Session::Session;
+
+        covent::task<std::size_t> process(std::string_view data) override {
+            co_return data.size();
+        }
+    };
+
+    // A plain blocking client; the kernel completes the handshake whether or not we've accepted yet.
+    int dial(unsigned short port) {
+        int sock = ::socket(AF_INET6, SOCK_STREAM, 0);
+        struct sockaddr_in6 sin6 {
+            .sin6_family = AF_INET6,
+            .sin6_port = htons(port),
+            .sin6_addr = IN6ADDR_LOOPBACK_INIT,
+        };
+        EXPECT_EQ(0, ::connect(sock, reinterpret_cast<struct sockaddr *>(&sin6), sizeof(sin6)));
+        return sock;
+    }
+
+    bool hung_up(int sock) {
+        pollfd p{.fd = sock, .events = POLLIN};
+        if (::poll(&p, 1, 100) != 1) return false;
+        char c;
+        return ::recv(sock, &c, 1, MSG_DONTWAIT) <= 0;
+    }
+
+    template<typename Fn>
+    void run_while(covent::Loop & loop, Fn fn) {
+        for (int i = 0; i != 500 && fn(); ++i) {
+            loop.run_once(false);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
+
+TEST(Admission, shed) {
+    covent::Loop loop;
+    covent::Listener<IdleSession> listener(loop, "::1", 2020);
+    listener.admission({.max_sessions = 2, .overload = covent::Admission::Overload::shed});
+    loop.listen(listener);
+    std::vector<int> clients;
+    for (int i = 0; i != 3; ++i) clients.push_back(dial(2020));
+    run_while(loop, [&listener]() { return listener.admission_stats().shed == 0; });
+    auto stats = listener.admission_stats();
+    EXPECT_EQ(2u, stats.accepted);
+    EXPECT_EQ(1u, stats.shed);
+    EXPECT_EQ(0u, stats.paused);
+    EXPECT_EQ(2u, stats.sessions);
+    EXPECT_FALSE(hung_up(clients[0]));
+    EXPECT_TRUE(hung_up(clients[2]));
+    for (auto sock : clients) ::close(sock);
+}
+
+TEST(Admission, pause) {
+    covent::Loop loop;
+    covent::Listener<IdleSession> listener(loop, "::1", 2020);
+    listener.admission({.max_sessions = 1, .recheck = 0.01});
+    loop.listen(listener);
+    std::vector<int> clients;
+    for (int i = 0; i != 3; ++i) clients.push_back(dial(2020));
+    run_while(loop, [&listener]() { return listener.admission_stats().paused == 0; });
+    EXPECT_EQ(1u, listener.admission_stats().accepted);
+    EXPECT_EQ(1u, listener.admission_stats().paused);
+    // Nobody's turned away; each waits its turn.
+    for (int i = 0; i != 2; ++i) {
+        ::close(clients[i]);
+        run_while(loop, [&listener, i]() { return listener.admission_stats().accepted < 2u + i; });
+        EXPECT_EQ(2u + i, listener.admission_stats().accepted);
+        EXPECT_EQ(1u, listener.admission_stats().sessions);
+    }
+    EXPECT_EQ(0u, listener.admission_stats().shed);
+    EXPECT_FALSE(hung_up(clients[2]));
+    ::close(clients[2]);
+}
+
+TEST(Admission, loop_limit) {
+    covent::Loop loop;
+    loop.max_sessions(1);
+    covent::Listener<IdleSession> listener(loop, "::1", 2020);
+    listener.admission({.overload = covent::Admission::Overload::shed});
+    loop.listen(listener);
+    auto first = dial(2020);
+    auto second = dial(2020);
+    run_while(loop, [&listener]() { return listener.admission_stats().shed == 0; });
+    EXPECT_EQ(1u, listener.admission_stats().accepted);
+    EXPECT_EQ(1u, loop.session_count());
+    EXPECT_TRUE(hung_up(second));
+    ::close(first);
+    ::close(second);
+}
+
+TEST(Admission, lag) {
+    covent::Loop loop;
+    covent::Listener<IdleSession> listener(loop, "::1", 2020);
+    listener.admission({.max_lag = 0.01, .overload = covent::Admission::Overload::shed});
+    loop.listen(listener);
+    auto before = dial(2020);
+    run_while(loop, [&listener]() { return listener.admission_stats().accepted == 0; });
+    EXPECT_EQ(1u, listener.admission_stats().accepted);
+    // Stall the loop, and wait for the probe to notice.
+    loop.defer([]() { std::this_thread::sleep_for(std::chrono::milliseconds(200)); });
+    run_while(loop, [&loop]() { return loop.lag() < 0.01; });
+    EXPECT_GT(loop.lag(), 0.01);
+    auto during = dial(2020);
+    run_while(loop, [&listener]() { return listener.admission_stats().shed == 0; });
+    EXPECT_EQ(1u, listener.admission_stats().shed);
+    EXPECT_TRUE(hung_up(during));
+    ::close(before);
+    ::close(during);
+}
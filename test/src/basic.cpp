@@ -3,8 +3,11 @@
 //
 
 #include <future>
+#include <optional>
 #include <thread>
 #include <covent/loop.h>
+#include <covent/sleep.h>
+#include <covent/loop-group.h>
 #include "gtest/gtest.h"
 
 TEST(Basic, create) {
@@ -79,4 +82,112 @@ TEST(Thread, simple) {
     auto task2 = loop.run_task(that_too(return_thread_id(thread_loop)));
     EXPECT_NE(std::hash<std::thread::id>{}(task1), std::hash<std::thread::id>{}(task2));
     // Above fails because the coroutine is resumed by the awaiter instead of start(), so it flips loop (possibly) only after a resume.
-}
\ No newline at end of file
+}
+
+TEST(Basic, cancel) {
+    covent::Loop loop;
+    bool trap = false;
+    auto timer = loop.defer([&trap]() {
+        trap = true;
+    }, 0.1);
+    EXPECT_TRUE(timer.pending());
+    EXPECT_TRUE(timer.cancel());
+    EXPECT_FALSE(timer.pending());
+    EXPECT_FALSE(timer.cancel());
+    loop.run_until_complete();
+    EXPECT_FALSE(trap);
+}
+
+namespace {
+    covent::task<void> nap() {
+        co_await covent::sleep(10.0);
+    }
+}
+
+// A sleep that outlives its Loop can still be destroyed; its timer handle just goes inert.
+TEST(Basic, outlives_loop) {
+    std::optional<covent::task<void>> task;
+    covent::TimerHandle timer;
+    {
+        covent::Loop loop;
+        timer = loop.defer([]() {}, 10.0);
+        task.emplace(nap());
+        task->start();
+        EXPECT_TRUE(timer.pending());
+    }
+    EXPECT_FALSE(timer.pending());
+    EXPECT_FALSE(timer.cancel());
+    EXPECT_FALSE(timer.reschedule(1.0));
+    task.reset();
+}
+
+TEST(Basic, reschedule) {
+    covent::Loop loop;
+    bool trap = false;
+    auto timer = loop.defer([&trap]() {
+        trap = true;
+    }, 10);
+    EXPECT_TRUE(timer.reschedule(0.1));
+    auto start = std::chrono::steady_clock::now();
+    loop.run_until_complete();
+    EXPECT_TRUE(trap);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+    EXPECT_FALSE(timer.pending());
+    EXPECT_FALSE(timer.reschedule(1));
+}
+
+namespace {
+    covent::task<void> sleepy() {
+        co_await covent::sleep(10);
+    }
+}
+
+TEST(Basic, sleep_cancelled) {
+    covent::Loop loop;
+    {
+        auto task = sleepy();
+        task.start();
+        EXPECT_FALSE(task.done());
+    }
+    // The task has gone, and its timer should have gone with it.
+    auto start = std::chrono::steady_clock::now();
+    loop.run_until_complete();
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+}
+
+TEST(Thread, post) {
+    covent::Loop loop;
+    auto & thread_loop = run_on_thread();
+    std::thread::id ran_on;
+    bool returned = false;
+    thread_loop.post([&loop, &ran_on, &returned]() {
+        ran_on = std::this_thread::get_id();
+        loop.post([&returned]() {
+            returned = true;
+        });
+    });
+    loop.run_until([&returned]() { return returned; });
+    EXPECT_TRUE(returned);
+    EXPECT_NE(ran_on, std::this_thread::get_id());
+    thread_loop.shutdown();
+}
+
+namespace {
+    covent::task<std::thread::id> group_thread_id(covent::Loop & l) {
+        EXPECT_EQ(&l, &covent::Loop::thread_loop());
+        co_return std::this_thread::get_id();
+    }
+}
+
+TEST(Thread, group) {
+    covent::LoopGroup group(2, false);
+    EXPECT_EQ(group.size(), 2);
+    auto id0 = group.run_task(group_thread_id(group.loop(0)));
+    auto id1 = group.run_task(group_thread_id(group.loop(1)));
+    EXPECT_NE(id0, id1);
+    EXPECT_NE(id0, std::this_thread::get_id());
+    EXPECT_EQ(id0, group.run_task(group_thread_id(group.loop(0))));
+    EXPECT_EQ(&group.next(), &group.loop(0));
+    EXPECT_EQ(&group.next(), &group.loop(1));
+    EXPECT_EQ(&group.next(), &group.loop(0));
+}
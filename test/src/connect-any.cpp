@@ -0,0 +1,129 @@
+//
+// Created by dwd on 10/17/26.
+//
+
+#include "gtest/gtest.h"
+#include <covent/covent.h>
+#include <covent/loop.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <chrono>
+#include <vector>
+
+namespace {
+    class Sink : public covent::Session {
+    public:
+        using covent::Session::Session;
+
+        covent::task<std::size_t> process(std::string_view data) override {
+            co_return data.size();
+        }
+    };
+
+    // A socket bound to a fresh port on ::1; listening, or not (so connections are refused).
+    struct Endpoint {
+        int fd;
+        struct sockaddr_storage addr = {};
+
+        explicit Endpoint(bool listening, int backlog = 16) : fd(::socket(AF_INET6, SOCK_STREAM, 0)) {
+            auto * sin6 = covent::sockaddr_cast<AF_INET6>(&addr);
+            sin6->sin6_family = AF_INET6;
+            sin6->sin6_addr = in6addr_loopback;
+            socklen_t len = sizeof(struct sockaddr_in6);
+            EXPECT_EQ(0, ::bind(fd, covent::sockaddr_cast<AF_UNSPEC>(&addr), len));
+            EXPECT_EQ(0, ::getsockname(fd, covent::sockaddr_cast<AF_UNSPEC>(&addr), &len));
+            if (listening) {
+                EXPECT_EQ(0, ::listen(fd, backlog));
+            }
+        }
+        ~Endpoint() {
+            ::close(fd);
+        }
+        [[nodiscard]] struct sockaddr const * sa() const {
+            return covent::sockaddr_cast<AF_UNSPEC>(&addr);
+        }
+    };
+
+    // Never accepts, and its queue's already full, so further SYNs just go unanswered.
+    struct Blackhole : Endpoint {
+        std::vector<int> fillers;
+
+        Blackhole() : Endpoint(true, 0) {
+            for (int i = 0; i != 2; ++i) {
+                auto c = ::socket(AF_INET6, SOCK_STREAM, 0);
+                evutil_make_socket_nonblocking(c);
+                ::connect(c, sa(), sizeof(struct sockaddr_in6));
+                fillers.push_back(c);
+            }
+        }
+        ~Blackhole() {
+            for (auto c : fillers) ::close(c);
+        }
+    };
+
+    double since(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+TEST(ConnectAny, stagger_and_history) {
+    covent::Loop loop;
+    Blackhole hole;
+    Endpoint good(true);
+    std::vector<struct sockaddr_storage> addresses = {hole.addr, good.addr};
+    auto first = std::make_shared<Sink>(loop);
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(1u, loop.run_task(first->connect_any(addresses, {.attempt_delay = 0.05, .timeout = 2})));
+    EXPECT_GE(since(start), 0.05); // Only tried once the first had had its chance.
+    ASSERT_TRUE(loop.connect_rtt(good.sa()).has_value());
+    ASSERT_TRUE(loop.connect_rtt(hole.sa()).has_value());
+    EXPECT_GE(*loop.connect_rtt(hole.sa()), 0.04);
+    EXPECT_LT(*loop.connect_rtt(good.sa()), *loop.connect_rtt(hole.sa()));
+    // Now it knows better, the good address goes first.
+    auto second = std::make_shared<Sink>(loop);
+    start = std::chrono::steady_clock::now();
+    EXPECT_EQ(1u, loop.run_task(second->connect_any(addresses, {.attempt_delay = 0.05, .timeout = 2})));
+    EXPECT_LT(since(start), 0.05);
+}
+
+TEST(ConnectAny, failure_moves_on) {
+    covent::Loop loop;
+    Endpoint refused(false);
+    Endpoint good(true);
+    std::vector<struct sockaddr_storage> addresses = {refused.addr, good.addr};
+    auto session = std::make_shared<Sink>(loop);
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(1u, loop.run_task(session->connect_any(addresses, {.attempt_delay = 5, .timeout = 10})));
+    EXPECT_LT(since(start), 1); // Didn't wait out the delay.
+    EXPECT_EQ(10, loop.connect_rtt(refused.sa()).value_or(0));
+}
+
+TEST(ConnectAny, all_fail) {
+    covent::Loop loop;
+    Endpoint refused(false);
+    Blackhole hole;
+    std::vector<struct sockaddr_storage> addresses = {refused.addr};
+    auto session = std::make_shared<Sink>(loop);
+    EXPECT_THROW(loop.run_task(session->connect_any(addresses)), covent::covent_runtime_error);
+    addresses = {hole.addr};
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_THROW(loop.run_task(session->connect_any(addresses, {.timeout = 0.2})), covent::covent_runtime_error);
+    EXPECT_GE(since(start), 0.2);
+    EXPECT_THROW(loop.run_task(session->connect_any({})), covent::covent_runtime_error);
+}
+
+// Past the limit, only the oldest hint goes.
+TEST(ConnectAny, rtt_eviction) {
+    covent::Loop loop;
+    auto hint = [](unsigned short port) { return covent::parse_sockaddr("127.0.0.1", port); };
+    for (unsigned short port = 1; port <= 4097; ++port) {
+        auto addr = hint(port);
+        loop.connect_rtt(covent::sockaddr_cast<AF_UNSPEC>(&addr), port, false);
+    }
+    auto first = hint(1);
+    auto second = hint(2);
+    auto last = hint(4097);
+    EXPECT_FALSE(loop.connect_rtt(covent::sockaddr_cast<AF_UNSPEC>(&first)).has_value());
+    EXPECT_EQ(2, loop.connect_rtt(covent::sockaddr_cast<AF_UNSPEC>(&second)).value_or(0));
+    EXPECT_EQ(4097, loop.connect_rtt(covent::sockaddr_cast<AF_UNSPEC>(&last)).value_or(0));
+}
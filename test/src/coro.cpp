@@ -134,7 +134,7 @@ TEST(CoroSigslot, sigslot_test_str) {
     covent::Loop loop;
     bool completed = false;
     auto task = sigslot_test_str();
-    auto handle = task.on_completed([&completed]() {
+    task.on_completed([&completed]() {
         completed = true;
     });
     auto t1 = task.start();
@@ -261,6 +261,61 @@ TEST(CoroThrow, nested_run_task) {
     EXPECT_ANY_THROW(loop.run_task(outer()));
 }
 
+namespace {
+    covent::task<bool> has_span() {
+        auto trans = covent::sentry::transaction::start("test.test", "tracking");
+        auto span = covent::sentry::span::start("fn.call", "tracking");
+        co_return span != nullptr;
+    }
+}
+
+TEST(CoroTracking, off) {
+    covent::Loop loop;
+    auto previous = covent::sentry::get_tracking();
+    covent::sentry::set_tracking(covent::sentry::tracking::off);
+    EXPECT_FALSE(loop.run_task(has_span()));
+    EXPECT_ANY_THROW(loop.run_task(outer()));
+    covent::sentry::set_tracking(previous);
+}
+
+namespace {
+    covent::task<bool> restacked() {
+        auto & p = co_await covent::own_promise<covent::task<bool>::promise_type>();
+        co_await run_suspend::nested();
+#ifdef COVENT_NO_SPAN_TRACKING
+        co_return true;
+#else
+        auto stack = covent::detail::Stack::thread_stack.lock();
+        co_return stack && stack->current_promise == &p;
+#endif
+    }
+}
+
+// Awaiting a task on the same Loop hands over directly; once it's done, we're the current promise again.
+TEST(CoroTracking, restack) {
+    covent::Loop loop;
+    auto previous = covent::sentry::get_tracking();
+    covent::sentry::set_tracking(covent::sentry::tracking::on);
+    EXPECT_TRUE(loop.run_task(restacked()));
+    covent::sentry::set_tracking(previous);
+}
+
+TEST(CoroTracking, sampled) {
+    covent::Loop loop;
+    auto previous = covent::sentry::get_tracking();
+    covent::sentry::set_tracking(covent::sentry::tracking::sampled, 4);
+    int tracked = 0;
+    for (int i = 0; i != 16; ++i) {
+        if (loop.run_task(has_span())) ++tracked;
+    }
+#ifdef COVENT_NO_SPAN_TRACKING
+    EXPECT_EQ(tracked, 0);
+#else
+    EXPECT_EQ(tracked, 4);
+#endif
+    covent::sentry::set_tracking(previous);
+}
+
 namespace {
     covent::task<std::unique_ptr<int>> unique_ptr_int(int x) {
         co_return std::make_unique<int>(x);
@@ -322,4 +377,63 @@ TEST(Generator, async) {
     covent::Loop loop;
     auto r = loop.run_task(counter_check());
     EXPECT_EQ(r, 45);
-}
\ No newline at end of file
+}
+
+TEST(Coro, task_ref) {
+    covent::Loop loop;
+    covent::task_ref ref;
+    {
+        bool trap = false;
+        auto task = run_single::empty(trap);
+        ref = covent::task_ref(task.handle);
+        EXPECT_TRUE(ref.alive());
+        task.start();
+        EXPECT_TRUE(ref.alive());
+    }
+    EXPECT_FALSE(ref.alive());
+    // The frame will most likely be reused here, but the old reference must stay dead.
+    bool trap = false;
+    auto again = run_single::empty(trap);
+    EXPECT_FALSE(ref.alive());
+    EXPECT_TRUE(covent::task_ref(again.handle).alive());
+}
+
+namespace {
+    // Over a MiB of frame, too big for any of the pool's classes.
+    covent::task<int> oversize(covent::future<int> & fut) {
+        std::array<char, 2 << 20> big;
+        big.fill(1);
+        big.back() = static_cast<char>(co_await fut);
+        co_return big.front() + big.back();
+    }
+}
+
+TEST(Coro, task_ref_oversize) {
+    covent::Loop loop;
+    covent::future<int> fut;
+    covent::task_ref ref;
+    {
+        auto task = oversize(fut);
+        ref = covent::task_ref(task.handle);
+        task.start();
+        EXPECT_TRUE(ref.alive());
+        fut.resolve(2);
+        loop.run_until_complete();
+        EXPECT_EQ(task.get(), 3);
+        EXPECT_TRUE(ref.alive());
+    }
+    EXPECT_FALSE(ref.alive());
+}
+
+TEST(Coro, on_completed_chain) {
+    covent::Loop loop;
+    std::vector<int> order;
+    bool trap = false;
+    auto task = run_single::empty(trap);
+    task.on_completed([&order]() { order.push_back(1); });
+    task.on_completed([&order]() { order.push_back(2); });
+    covent::detail::continuation third{[](void * o) { static_cast<std::vector<int> *>(o)->push_back(3); }, &order};
+    covent::detail::set_continuation(task.handle.promise(), third);
+    task.start();
+    EXPECT_EQ(order, (std::vector<int>{1, 2, 3}));
+}
@@ -0,0 +1,132 @@
+//
+// Created by dwd on 10/17/26.
+//
+
+#include "gtest/gtest.h"
+#include <covent/covent.h>
+#include <covent/datagram.h>
+#include <covent/loop.h>
+#include <string>
+#include <vector>
+
+namespace {
+    covent::task<std::vector<std::string>> receive(covent::DatagramEndpoint & endpoint, std::size_t count, std::string * from = nullptr) {
+        std::vector<std::string> received;
+        while (received.size() < count) {
+            auto batch = co_await endpoint.recv_batch();
+            for (auto const & datagram : batch) {
+                received.emplace_back(datagram.data);
+                if (from && datagram.peer) *from = covent::address_tostring(datagram.peer) + "#" + std::to_string(covent::address_toport(datagram.peer));
+            }
+        }
+        co_return received;
+    }
+
+    std::string name_of(covent::DatagramEndpoint const & endpoint) {
+        return covent::address_tostring(endpoint.sockaddr()) + "#" + std::to_string(covent::address_toport(endpoint.sockaddr()));
+    }
+}
+
+TEST(Datagram, roundtrip) {
+    covent::Loop loop;
+    covent::DatagramEndpoint a(loop, "::1", 0);
+    covent::DatagramEndpoint b(loop, "::1", 0);
+    EXPECT_NE(0, covent::address_toport(a.sockaddr()));
+    std::vector<covent::Datagram> out = {
+        {"one", b.sockaddr()},
+        {"two", b.sockaddr()},
+        {"three", b.sockaddr()},
+    };
+    loop.run_task(a.send_batch(out));
+    std::string from;
+    auto received = loop.run_task(receive(b, 3, &from));
+    EXPECT_EQ((std::vector<std::string>{"one", "two", "three"}), received);
+    EXPECT_EQ(name_of(a), from);
+    EXPECT_EQ(3u, a.stats().sent);
+    EXPECT_EQ(3u, b.stats().received);
+}
+
+TEST(Datagram, waits) {
+    covent::Loop loop;
+    covent::DatagramEndpoint a(loop, "127.0.0.1", 0);
+    covent::DatagramEndpoint b(loop, "127.0.0.1", 0);
+    EXPECT_TRUE(b.try_recv().empty());
+    auto pending = receive(b, 1);
+    pending.start();
+    EXPECT_FALSE(pending.done());
+    a.connect(b.sockaddr());
+    std::vector<covent::Datagram> out = {{"ping"}};
+    EXPECT_EQ(1u, a.try_send(out));
+    loop.run_until([&pending]() { return pending.done(); });
+    EXPECT_EQ(std::vector<std::string>{"ping"}, pending.get());
+}
+
+// Equal sizes to one peer go out as a single GSO send where the kernel can, and arrive as one GRO slot
+// where it can; either way, what comes out is what went in.
+TEST(Datagram, coalesced) {
+    covent::Loop loop;
+    covent::DatagramEndpoint a(loop, "::1", 0);
+    covent::DatagramEndpoint b(loop, "::1", 0);
+    std::vector<std::string> payloads;
+    for (int i = 0; i != 10; ++i) payloads.push_back(std::string(100, static_cast<char>('a' + i)));
+    payloads.push_back("short");
+    std::vector<covent::Datagram> out;
+    for (auto const & p : payloads) out.push_back({p, b.sockaddr()});
+    loop.run_task(a.send_batch(out));
+    EXPECT_EQ(11u, a.stats().sent);
+    EXPECT_LE(a.stats().send_calls, 1u);
+    auto received = loop.run_task(receive(b, payloads.size()));
+    EXPECT_EQ(payloads, received);
+}
+
+// Segments too big for an unknown path go out one by one; once connected, the route's MTU decides.
+TEST(Datagram, coalesced_large) {
+    covent::Loop loop;
+    covent::DatagramEndpoint a(loop, "::1", 0);
+    covent::DatagramEndpoint b(loop, "::1", 0);
+    std::vector<std::string> payloads;
+    for (int i = 0; i != 4; ++i) payloads.push_back(std::string(4000, static_cast<char>('a' + i)));
+    std::vector<covent::Datagram> out;
+    for (auto const & p : payloads) out.push_back({p, b.sockaddr()});
+    loop.run_task(a.send_batch(out));
+    EXPECT_EQ(payloads, loop.run_task(receive(b, payloads.size())));
+    a.connect(b.sockaddr());
+    out.clear();
+    for (auto const & p : payloads) out.push_back({p});
+    loop.run_task(a.send_batch(out));
+    EXPECT_EQ(8u, a.stats().sent);
+    EXPECT_EQ(payloads, loop.run_task(receive(b, payloads.size())));
+}
+
+TEST(Datagram, truncated) {
+    covent::Loop loop;
+    covent::DatagramEndpoint a(loop, "::1", 0);
+    covent::DatagramEndpoint b(loop, "::1", 0, {.max_size = 16, .gro = false});
+    std::string big(64, 'x');
+    std::vector<covent::Datagram> out = {{big, b.sockaddr()}};
+    loop.run_task(a.send_batch(out));
+    auto received = loop.run_task(receive(b, 1));
+    EXPECT_EQ(std::string(16, 'x'), received.front());
+    EXPECT_EQ(1u, b.stats().truncated);
+}
+
+TEST(Datagram, batch_outlives_endpoint) {
+    covent::Loop loop;
+    covent::DatagramEndpoint a(loop, "::1", 0);
+    covent::DatagramBatch batch;
+    {
+        covent::DatagramEndpoint b(loop, "::1", 0);
+        std::vector<covent::Datagram> out = {{"kept", b.sockaddr()}};
+        loop.run_task(a.send_batch(out));
+        batch = loop.run_task(b.recv_batch());
+    }
+    ASSERT_EQ(1u, batch.size());
+    EXPECT_EQ("kept", batch[0].data);
+}
+
+TEST(Datagram, no_peer) {
+    covent::Loop loop;
+    covent::DatagramEndpoint a(loop, "::1", 0);
+    std::vector<covent::Datagram> out = {{"nowhere"}};
+    EXPECT_THROW(a.try_send(out), covent::covent_logic_error);
+}
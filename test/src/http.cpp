@@ -5,6 +5,7 @@
 #include <covent/http.h>
 #include <covent/loop.h>
 #include "gtest/gtest.h"
+#include <unistd.h>
 
 TEST(HTTP, RequestHeaderRead) {
     covent::Loop loop;
@@ -248,3 +249,53 @@ TEST(HTTP_Server, MiddlewareOnRoot) {
         EXPECT_EQ(resp->status(), 401);
     }
 }
+
+TEST(HTTP_Server, SendFile) {
+    covent::Loop loop;
+    covent::http::Server srv(8001, false);
+    char path[] = "/tmp/covent-send-file-XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    ::unlink(path);
+    std::string const content = "0123456789abcdefghij";
+    ASSERT_EQ(static_cast<ssize_t>(content.size()), ::write(fd, content.data(), content.size()));
+    srv.add(std::make_unique<covent::http::Endpoint>("/"));
+    srv.add(std::make_unique<covent::http::Endpoint>("/file", [fd](evhttp_request * req) -> covent::task<int> {
+        co_return covent::http::send_file(req, fd, "text/plain");
+    }));
+    {
+        covent::http::Request req(covent::http::Method::GET, "http://localhost:8001/file");
+        auto resp = loop.run_task(req());
+        EXPECT_EQ(resp->status(), 200);
+        EXPECT_EQ(resp->body(), content);
+    }
+    {
+        covent::http::Request req(covent::http::Method::GET, "http://localhost:8001/file");
+        req["Range"] = "bytes=5-9";
+        auto resp = loop.run_task(req());
+        EXPECT_EQ(resp->status(), 206);
+        EXPECT_EQ(resp->body(), "56789");
+        EXPECT_EQ((*resp)["Content-Range"], "bytes 5-9/20");
+    }
+    {
+        covent::http::Request req(covent::http::Method::GET, "http://localhost:8001/file");
+        req["Range"] = "bytes=-3";
+        auto resp = loop.run_task(req());
+        EXPECT_EQ(resp->status(), 206);
+        EXPECT_EQ(resp->body(), "hij");
+    }
+    {
+        covent::http::Request req(covent::http::Method::GET, "http://localhost:8001/file");
+        req["Range"] = "bytes=15-";
+        auto resp = loop.run_task(req());
+        EXPECT_EQ(resp->status(), 206);
+        EXPECT_EQ(resp->body(), "fghij");
+    }
+    {
+        covent::http::Request req(covent::http::Method::GET, "http://localhost:8001/file");
+        req["Range"] = "bytes=20-";
+        auto resp = loop.run_task(req());
+        EXPECT_EQ(resp->status(), 416);
+    }
+    ::close(fd);
+}
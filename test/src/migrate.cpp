@@ -0,0 +1,131 @@
+//
+// Created by dwd on 10/17/26.
+//
+
+#include "gtest/gtest.h"
+#include <covent/covent.h>
+#include <covent/listener.h>
+#include <covent/loop.h>
+#include <covent/loop-group.h>
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <future>
+#include <memory>
+#include <string>
+
+namespace {
+    covent::Loop * s_target = nullptr;
+
+    // Answers each line with where it ran: "0" on the loop it started on, "1" once it's on the target.
+    class Mover : public covent::Session {
+    public:
+        using covent::Session::Session;
+
+        covent::task<std::size_t> process(std::string_view data) override {
+            auto eol = data.find('\n');
+            if (eol == std::string_view::npos) co_return 0;
+            if (data.starts_with("move")) co_await migrate(*s_target);
+            write(&loop() == s_target && loop().on_loop_thread() ? "1\n" : "0\n");
+            co_return eol + 1;
+        }
+    };
+
+    std::shared_ptr<Mover> start(covent::Loop & loop, covent::ListenerBase & listener, int fd, SSL_CTX * ctx = nullptr) {
+        std::promise<std::shared_ptr<Mover>> created;
+        loop.post([&]() {
+            auto session = std::make_shared<Mover>(loop, fd, listener);
+            loop.add(session);
+            if (ctx) session->ssl(SSL_new(ctx), false);
+            created.set_value(session);
+        });
+        return created.get_future().get();
+    }
+
+    std::size_t count(covent::Loop & loop) {
+        std::promise<std::size_t> n;
+        loop.post([&]() { n.set_value(loop.session_count()); });
+        return n.get_future().get();
+    }
+
+    int peer_socket(int fds[2]) {
+        EXPECT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+        evutil_make_socket_nonblocking(fds[0]);
+        struct timeval tv{5, 0};
+        setsockopt(fds[1], SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        return fds[1];
+    }
+
+    std::string ask(int fd, std::string const & line) {
+        EXPECT_EQ(static_cast<ssize_t>(line.size()), ::send(fd, line.data(), line.size(), MSG_NOSIGNAL));
+        char buf[16];
+        auto n = ::recv(fd, buf, sizeof(buf), 0);
+        return n > 0 ? std::string(buf, static_cast<std::size_t>(n)) : std::string{};
+    }
+
+    std::string ask(SSL * ssl, std::string const & line) {
+        EXPECT_EQ(static_cast<int>(line.size()), SSL_write(ssl, line.data(), static_cast<int>(line.size())));
+        char buf[16];
+        auto n = SSL_read(ssl, buf, sizeof(buf));
+        return n > 0 ? std::string(buf, static_cast<std::size_t>(n)) : std::string{};
+    }
+
+    // A throwaway self-signed certificate, so the server end has something to present.
+    std::unique_ptr<SSL_CTX, decltype(&SSL_CTX_free)> server_context() {
+        std::unique_ptr<SSL_CTX, decltype(&SSL_CTX_free)> ctx(SSL_CTX_new(TLS_server_method()), SSL_CTX_free);
+        std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)> key(EVP_PKEY_Q_keygen(nullptr, nullptr, "EC", "P-256"), EVP_PKEY_free);
+        std::unique_ptr<X509, decltype(&X509_free)> cert(X509_new(), X509_free);
+        ASN1_INTEGER_set(X509_get_serialNumber(cert.get()), 1);
+        X509_gmtime_adj(X509_getm_notBefore(cert.get()), 0);
+        X509_gmtime_adj(X509_getm_notAfter(cert.get()), 3600);
+        X509_set_pubkey(cert.get(), key.get());
+        X509_NAME_add_entry_by_txt(X509_get_subject_name(cert.get()), "CN", MBSTRING_ASC, reinterpret_cast<unsigned char const *>("localhost"), -1, -1, 0);
+        X509_set_issuer_name(cert.get(), X509_get_subject_name(cert.get()));
+        X509_sign(cert.get(), key.get(), EVP_sha256());
+        SSL_CTX_use_certificate(ctx.get(), cert.get());
+        SSL_CTX_use_PrivateKey(ctx.get(), key.get());
+        return ctx;
+    }
+}
+
+TEST(Migrate, plain) {
+    covent::LoopGroup group(2, false);
+    s_target = &group.loop(1);
+    covent::Listener<Mover> listener(group.loop(0), "::1", 0); // Never listens.
+    int fds[2];
+    auto peer = peer_socket(fds);
+    auto session = start(group.loop(0), listener, fds[0]);
+    EXPECT_EQ("0\n", ask(peer, "ping\n"));
+    EXPECT_EQ("1\n", ask(peer, "move\n"));
+    EXPECT_EQ("1\n", ask(peer, "ping\n"));
+    EXPECT_EQ(&group.loop(1), &session->loop());
+    EXPECT_EQ(0u, count(group.loop(0)));
+    EXPECT_EQ(1u, count(group.loop(1)));
+    session.reset();
+    ::close(peer);
+}
+
+TEST(Migrate, tls) {
+    covent::LoopGroup group(2, false);
+    s_target = &group.loop(1);
+    covent::Listener<Mover> listener(group.loop(0), "::1", 0); // Never listens.
+    auto server_ctx = server_context();
+    std::unique_ptr<SSL_CTX, decltype(&SSL_CTX_free)> client_ctx(SSL_CTX_new(TLS_client_method()), SSL_CTX_free);
+    int fds[2];
+    auto peer = peer_socket(fds);
+    auto session = start(group.loop(0), listener, fds[0], server_ctx.get());
+    std::unique_ptr<SSL, decltype(&SSL_free)> client(SSL_new(client_ctx.get()), SSL_free);
+    SSL_set_fd(client.get(), peer);
+    ASSERT_EQ(1, SSL_connect(client.get()));
+    EXPECT_EQ("0\n", ask(client.get(), "ping\n"));
+    EXPECT_EQ("1\n", ask(client.get(), "move\n"));
+    EXPECT_EQ("1\n", ask(client.get(), "ping\n"));
+    std::string const big(256 << 10, 'x'); // Plenty of records, on the new loop.
+    EXPECT_EQ("1\n", ask(client.get(), big + "\n"));
+    EXPECT_EQ(1u, count(group.loop(1)));
+    session.reset();
+    ::close(peer);
+}
@@ -0,0 +1,93 @@
+//
+// Created by dwd on 10/17/26.
+//
+
+#include <covent/loop.h>
+#include <covent/offload.h>
+#include <chrono>
+#include <future>
+#include "gtest/gtest.h"
+
+namespace {
+    covent::task<std::pair<std::thread::id, std::thread::id>> offloaded(covent::OffloadPool & pool) {
+        auto worker = co_await covent::offload([]() {
+            return std::this_thread::get_id();
+        }, pool);
+        co_return std::make_pair(worker, std::this_thread::get_id());
+    }
+
+    covent::task<int> offloaded_throw(covent::OffloadPool & pool) {
+        co_await covent::offload([]() {
+            throw std::runtime_error("Boom");
+        }, pool);
+        co_return 1;
+    }
+
+    covent::task<int> offloaded_many(covent::OffloadPool & pool, int count) {
+        int total = 0;
+        for (int i = 0; i != count; ++i) {
+            total += co_await covent::offload([i]() {
+                return i;
+            }, pool);
+        }
+        co_return total;
+    }
+}
+
+TEST(Offload, resumes_on_loop) {
+    covent::Loop loop;
+    covent::OffloadPool pool(2);
+    auto [worker, resumed] = loop.run_task(offloaded(pool));
+    EXPECT_NE(worker, std::this_thread::get_id());
+    EXPECT_EQ(resumed, std::this_thread::get_id());
+}
+
+TEST(Offload, exception) {
+    covent::Loop loop;
+    covent::OffloadPool pool(1);
+    EXPECT_THROW(loop.run_task(offloaded_throw(pool)), std::runtime_error);
+}
+
+TEST(Offload, metrics) {
+    covent::Loop loop;
+    covent::OffloadPool pool(3);
+    EXPECT_EQ(loop.run_task(offloaded_many(pool, 100)), 4950);
+    // A worker counts a job only once it's returned, which can be after the task has already been resumed; so
+    // let the pool settle first.
+    auto const deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    covent::OffloadPool::Metrics metrics;
+    std::uint64_t executed;
+    do {
+        metrics = pool.metrics();
+        executed = 0;
+        for (auto const & worker : metrics.workers) executed += worker.executed;
+    } while (executed != 100 && std::chrono::steady_clock::now() < deadline);
+    EXPECT_EQ(metrics.submitted, 100);
+    ASSERT_EQ(metrics.workers.size(), 3);
+    for (auto const & worker : metrics.workers) {
+        EXPECT_EQ(worker.queued, 0);
+    }
+    EXPECT_EQ(executed, 100);
+}
+
+TEST(Offload, steal) {
+    covent::OffloadPool pool(2);
+    std::atomic<int> count = 0;
+    std::promise<void> release;
+    auto gate = release.get_future().share();
+    // Park one worker, then queue work behind it; the other worker has to steal it.
+    std::atomic<bool> parked = false;
+    pool.submit([gate, &parked]() {
+        parked = true;
+        gate.wait();
+    });
+    while (!parked) std::this_thread::yield();
+    for (int i = 0; i != 20; ++i) {
+        pool.submit([&count]() { ++count; });
+    }
+    while (count != 20) std::this_thread::yield();
+    release.set_value();
+    std::uint64_t stolen = 0;
+    for (auto const & worker : pool.metrics().workers) stolen += worker.stolen;
+    EXPECT_GT(stolen, 0);
+}
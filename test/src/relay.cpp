@@ -0,0 +1,258 @@
+//
+// Created by dwd on 10/17/26.
+//
+
+#include "gtest/gtest.h"
+#include <covent/covent.h>
+#include <covent/listener.h>
+#include <covent/loop.h>
+#include <covent/loop-group.h>
+#include <covent/relay.h>
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <future>
+#include <memory>
+#include <optional>
+#include <string>
+
+namespace {
+    // Never consumes anything, so whatever arrives before the relay starts is still there when it does.
+    class Idle : public covent::Session {
+    public:
+        using covent::Session::Session;
+
+        covent::task<std::size_t> process(std::string_view) override {
+            co_return 0;
+        }
+    };
+
+    // A proxy's two sessions, each with the far end of its socket: the client's, and the backend's.
+    struct Proxy {
+        covent::Loop & loop;
+        covent::Listener<Idle> listener;
+        int client = -1;
+        int backend = -1;
+        std::shared_ptr<Idle> a;
+        std::shared_ptr<Idle> b;
+
+        explicit Proxy(covent::Loop & l) : loop(l), listener(l, "::1", 0) { // Never listens.
+            int fds[2];
+            EXPECT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+            evutil_make_socket_nonblocking(fds[0]);
+            client = fds[1];
+            a = std::make_shared<Idle>(loop, fds[0], listener);
+            EXPECT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+            evutil_make_socket_nonblocking(fds[0]);
+            backend = fds[1];
+            b = std::make_shared<Idle>(loop, fds[0], listener);
+            loop.add(a);
+            loop.add(b);
+            for (auto fd : {client, backend}) {
+                struct timeval tv{5, 0};
+                setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+            }
+        }
+        ~Proxy() {
+            ::close(client);
+            ::close(backend);
+        }
+
+        void send(int fd, std::string const & data) const {
+            EXPECT_EQ(static_cast<ssize_t>(data.size()), ::send(fd, data.data(), data.size(), MSG_NOSIGNAL));
+        }
+        // Run the loop until len octets have arrived on fd, or it's closed.
+        std::string receive(int fd, std::size_t len) const {
+            std::string received;
+            char buf[65536];
+            for (int i = 0; i != 20000 && received.size() < len; ++i) {
+                loop.run_once(false);
+                auto n = ::recv(fd, buf, std::min(sizeof(buf), len - received.size()), MSG_DONTWAIT);
+                if (n == 0) break;
+                if (n > 0) received.append(buf, static_cast<std::size_t>(n));
+            }
+            return received;
+        }
+        bool hung_up(int fd) const {
+            char c;
+            for (int i = 0; i != 20000; ++i) {
+                loop.run_once(false);
+                auto n = ::recv(fd, &c, 1, MSG_DONTWAIT);
+                if (n == 0) return true;
+                if (n > 0) return false;
+            }
+            return false;
+        }
+    };
+
+    void half_close(bool splice) {
+        covent::Loop loop;
+        Proxy proxy(loop);
+        proxy.send(proxy.client, "early"); // Read before the relay starts.
+        loop.run_once(false);
+        auto task = covent::relay(*proxy.a, *proxy.b, {.splice = splice});
+        task.start();
+        EXPECT_EQ("early", proxy.receive(proxy.backend, 5));
+        proxy.send(proxy.client, "hello");
+        EXPECT_EQ("hello", proxy.receive(proxy.backend, 5));
+        proxy.send(proxy.backend, "world");
+        EXPECT_EQ("world", proxy.receive(proxy.client, 5));
+        // The client's done sending; the backend hears that, but can still answer.
+        ::shutdown(proxy.client, SHUT_WR);
+        EXPECT_TRUE(proxy.hung_up(proxy.backend));
+        proxy.send(proxy.backend, "late");
+        EXPECT_EQ("late", proxy.receive(proxy.client, 4));
+        EXPECT_FALSE(task.done());
+        ::shutdown(proxy.backend, SHUT_WR);
+        EXPECT_TRUE(proxy.hung_up(proxy.client));
+        loop.run_until([&task]() { return task.done(); });
+        auto stats = task.get();
+        EXPECT_EQ(10u, stats.a_to_b);
+        EXPECT_EQ(9u, stats.b_to_a);
+        EXPECT_EQ(splice, stats.spliced);
+        EXPECT_FALSE(stats.aborted);
+    }
+
+    void backpressure(bool splice) {
+        covent::Loop loop;
+        Proxy proxy(loop);
+        evutil_make_socket_nonblocking(proxy.client);
+        auto task = covent::relay(*proxy.a, *proxy.b, {.buffer = 64 << 10, .splice = splice});
+        task.start();
+        // The backend isn't reading, so once the sockets fill, the client has to stop too - rather than
+        // the proxy soaking it all up.
+        std::string const chunk(64 << 10, 'x');
+        std::size_t sent = 0;
+        for (int i = 0; i != 1000; ++i) {
+            auto n = ::send(proxy.client, chunk.data(), chunk.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (n > 0) sent += static_cast<std::size_t>(n);
+            loop.run_once(false);
+        }
+        EXPECT_LT(sent, 1000 * chunk.size());
+        EXPECT_LE(proxy.a->buffered() + proxy.b->buffered(), (64u << 10) + (64u << 10));
+        EXPECT_EQ(std::string(sent, 'x'), proxy.receive(proxy.backend, sent));
+        ::shutdown(proxy.client, SHUT_WR);
+        ::shutdown(proxy.backend, SHUT_WR);
+        loop.run_until([&task]() { return task.done(); });
+        EXPECT_EQ(sent, task.get().a_to_b);
+    }
+
+    // A throwaway self-signed certificate, so the server end has something to present.
+    std::unique_ptr<SSL_CTX, decltype(&SSL_CTX_free)> server_context() {
+        std::unique_ptr<SSL_CTX, decltype(&SSL_CTX_free)> ctx(SSL_CTX_new(TLS_server_method()), SSL_CTX_free);
+        std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)> key(EVP_PKEY_Q_keygen(nullptr, nullptr, "EC", "P-256"), EVP_PKEY_free);
+        std::unique_ptr<X509, decltype(&X509_free)> cert(X509_new(), X509_free);
+        ASN1_INTEGER_set(X509_get_serialNumber(cert.get()), 1);
+        X509_gmtime_adj(X509_getm_notBefore(cert.get()), 0);
+        X509_gmtime_adj(X509_getm_notAfter(cert.get()), 3600);
+        X509_set_pubkey(cert.get(), key.get());
+        X509_NAME_add_entry_by_txt(X509_get_subject_name(cert.get()), "CN", MBSTRING_ASC, reinterpret_cast<unsigned char const *>("localhost"), -1, -1, 0);
+        X509_set_issuer_name(cert.get(), X509_get_subject_name(cert.get()));
+        X509_sign(cert.get(), key.get(), EVP_sha256());
+        SSL_CTX_use_certificate(ctx.get(), cert.get());
+        SSL_CTX_use_PrivateKey(ctx.get(), key.get());
+        return ctx;
+    }
+
+    std::string blocking_recv(int fd, std::size_t len) {
+        std::string received;
+        char buf[256];
+        while (received.size() < len) {
+            auto n = ::recv(fd, buf, std::min(sizeof(buf), len - received.size()), 0);
+            if (n <= 0) break;
+            received.append(buf, static_cast<std::size_t>(n));
+        }
+        return received;
+    }
+}
+
+TEST(Relay, splice) {
+    half_close(true);
+}
+
+TEST(Relay, buffers) {
+    half_close(false);
+}
+
+TEST(Relay, splice_backpressure) {
+    backpressure(true);
+}
+
+TEST(Relay, buffers_backpressure) {
+    backpressure(false);
+}
+
+TEST(Relay, abort) {
+    covent::Loop loop;
+    Proxy proxy(loop);
+    auto task = covent::relay(*proxy.a, *proxy.b);
+    task.start();
+    proxy.b->close();
+    loop.run_until([&task]() { return task.done(); });
+    EXPECT_TRUE(task.get().aborted);
+    EXPECT_TRUE(proxy.hung_up(proxy.client));
+}
+
+TEST(Relay, busy) {
+    covent::Loop loop;
+    Proxy proxy(loop);
+    auto first = covent::relay(*proxy.a, *proxy.b);
+    first.start();
+    Proxy other(loop);
+    auto second = covent::relay(*proxy.a, *other.b);
+    EXPECT_THROW(loop.run_task(std::move(second)), covent::covent_logic_error);
+}
+
+// The client speaks TLS to the proxy, which talks plain to the backend.
+TEST(Relay, tls) {
+    covent::LoopGroup group(1, false);
+    auto & loop = group.loop(0);
+    auto server_ctx = server_context();
+    std::unique_ptr<SSL_CTX, decltype(&SSL_CTX_free)> client_ctx(SSL_CTX_new(TLS_client_method()), SSL_CTX_free);
+    std::optional<Proxy> proxy;
+    std::optional<covent::task<void>> runner;
+    std::promise<covent::RelayStats> result;
+    std::promise<void> started;
+    loop.post([&]() {
+        proxy.emplace(loop);
+        proxy->a->ssl(SSL_new(server_ctx.get()), false);
+        runner.emplace([](Proxy & p, std::promise<covent::RelayStats> & r) -> covent::task<void> {
+            r.set_value(co_await covent::relay(*p.a, *p.b));
+        }(*proxy, result));
+        runner->start();
+        started.set_value();
+    });
+    started.get_future().wait();
+    std::unique_ptr<SSL, decltype(&SSL_free)> client(SSL_new(client_ctx.get()), SSL_free);
+    SSL_set_fd(client.get(), proxy->client);
+    ASSERT_EQ(1, SSL_connect(client.get()));
+    EXPECT_EQ(5, SSL_write(client.get(), "hello", 5));
+    EXPECT_EQ("hello", blocking_recv(proxy->backend, 5));
+    EXPECT_EQ(5, ::send(proxy->backend, "world", 5, MSG_NOSIGNAL));
+    char buf[16];
+    EXPECT_EQ(5, SSL_read(client.get(), buf, sizeof(buf)));
+    // close_notify from the client half-closes the backend; the answer still comes back.
+    EXPECT_EQ(0, SSL_shutdown(client.get()));
+    EXPECT_EQ("", blocking_recv(proxy->backend, 1));
+    EXPECT_EQ(4, ::send(proxy->backend, "late", 4, MSG_NOSIGNAL));
+    EXPECT_EQ(4, SSL_read(client.get(), buf, sizeof(buf)));
+    // And the backend finishing turns into the proxy's close_notify.
+    ::shutdown(proxy->backend, SHUT_WR);
+    EXPECT_EQ(0, SSL_read(client.get(), buf, sizeof(buf)));
+    EXPECT_EQ(SSL_ERROR_ZERO_RETURN, SSL_get_error(client.get(), 0));
+    auto stats = result.get_future().get();
+    EXPECT_EQ(5u, stats.a_to_b);
+    EXPECT_EQ(9u, stats.b_to_a);
+    EXPECT_FALSE(stats.spliced);
+    EXPECT_FALSE(stats.aborted);
+    std::promise<void> done;
+    loop.post([&]() {
+        runner.reset();
+        proxy.reset();
+        done.set_value();
+    });
+    done.get_future().wait();
+}
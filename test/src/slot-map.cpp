@@ -0,0 +1,55 @@
+//
+// Created by dwd on 10/17/26.
+//
+
+#include <covent/slot-map.h>
+#include <memory>
+#include <gtest/gtest.h>
+
+namespace {
+    using Map = covent::detail::SlotMap<std::shared_ptr<int>>;
+}
+
+GTEST_TEST(SlotMap, attach_find) {
+    Map map;
+    auto id = map.reserve();
+    EXPECT_NE(id, 0);
+    EXPECT_FALSE(map.contains(id));
+    EXPECT_TRUE(map.empty());
+    EXPECT_TRUE(map.attach(id, std::make_shared<int>(42)));
+    ASSERT_NE(map.find(id), nullptr);
+    EXPECT_EQ(**map.find(id), 42);
+    EXPECT_EQ(map.size(), 1);
+    EXPECT_TRUE(map.detach(id));
+    EXPECT_FALSE(map.detach(id));
+    EXPECT_EQ(map.find(id), nullptr);
+    EXPECT_TRUE(map.empty());
+    // Still reserved, so it can be attached again.
+    EXPECT_TRUE(map.attach(id, std::make_shared<int>(43)));
+    EXPECT_EQ(**map.find(id), 43);
+}
+
+GTEST_TEST(SlotMap, stale) {
+    Map map;
+    auto id1 = map.reserve();
+    map.attach(id1, std::make_shared<int>(1));
+    map.release(id1);
+    EXPECT_TRUE(map.empty());
+    auto id2 = map.reserve();
+    // Same slot, new generation.
+    EXPECT_EQ(id1 & 0xFFFFFFFF, id2 & 0xFFFFFFFF);
+    EXPECT_NE(id1, id2);
+    EXPECT_FALSE(map.attach(id1, std::make_shared<int>(2)));
+    EXPECT_TRUE(map.attach(id2, std::make_shared<int>(3)));
+    EXPECT_EQ(map.find(id1), nullptr);
+    EXPECT_EQ(**map.find(id2), 3);
+}
+
+GTEST_TEST(SlotMap, drain) {
+    Map map;
+    for (int i = 0; i != 10; ++i) map.attach(map.reserve(), std::make_shared<int>(i));
+    std::vector<std::shared_ptr<int>> out;
+    map.drain(out);
+    EXPECT_EQ(out.size(), 10);
+    EXPECT_TRUE(map.empty());
+}
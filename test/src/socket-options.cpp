@@ -0,0 +1,92 @@
+//
+// Created by dwd on 10/17/26.
+//
+
+#include "gtest/gtest.h"
+#include <covent/covent.h>
+#include <covent/listener.h>
+#include <covent/loop.h>
+#include <event2/bufferevent.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+
+namespace {
+    evutil_socket_t s_accepted = -1;
+
+    class TunedSession : public covent::Session {
+    public:
+        TunedSession(covent::Loop & l, evutil_socket_t sock, covent::ListenerBase & b) : covent::Session(l, sock, b) {
+            s_accepted = sock;
+        }
+        using covent::Session::Session;
+
+        covent::task<std::size_t> process(std::string_view data) override {
+            co_return data.size();
+        }
+    };
+
+    int option(evutil_socket_t sock, int level, int name) {
+        int value = -1;
+        socklen_t len = sizeof(value);
+        EXPECT_EQ(0, ::getsockopt(sock, level, name, &value, &len));
+        return value;
+    }
+}
+
+TEST(SocketOptions, listen_and_connect) {
+    covent::Loop loop;
+    s_accepted = -1;
+    covent::SocketOptions server_options{
+        .nodelay = true,
+        .receive_buffer = 256 << 10,
+        .keepalive_idle = 30,
+        .keepalive_interval = 5,
+        .keepalive_count = 3,
+        .user_timeout = 5000,
+        .tos = 0x10,
+        .fastopen = 16,
+        .defer_accept = 1,
+        .backlog = 16,
+    };
+    covent::Listener<TunedSession> listener(loop, "::1", 2018, server_options);
+    loop.listen(listener);
+
+    auto client = std::make_shared<TunedSession>(loop);
+    loop.add(client);
+    struct sockaddr_in6 sin6 {
+        .sin6_family = AF_INET6,
+        .sin6_port = htons(2018),
+        .sin6_addr = IN6ADDR_LOOPBACK_INIT,
+    };
+    loop.run_task(client->connect(&sin6, {.nodelay = true, .keepalive_idle = 45, .user_timeout = 2000}));
+    client->write("x"); // With TCP_DEFER_ACCEPT, nothing's accepted until there's data.
+    for (int i = 0; i != 100 && s_accepted < 0; ++i) loop.run_once(false);
+    ASSERT_GE(s_accepted, 0);
+
+    // Accepted connections inherit from the listening socket.
+    EXPECT_NE(0, option(s_accepted, IPPROTO_TCP, TCP_NODELAY));
+    EXPECT_GE(option(s_accepted, SOL_SOCKET, SO_RCVBUF), 256 << 10); // Linux doubles it.
+    EXPECT_NE(0, option(s_accepted, SOL_SOCKET, SO_KEEPALIVE));
+    EXPECT_EQ(30, option(s_accepted, IPPROTO_TCP, TCP_KEEPIDLE));
+    EXPECT_EQ(5, option(s_accepted, IPPROTO_TCP, TCP_KEEPINTVL));
+    EXPECT_EQ(3, option(s_accepted, IPPROTO_TCP, TCP_KEEPCNT));
+    EXPECT_EQ(5000, option(s_accepted, IPPROTO_TCP, TCP_USER_TIMEOUT));
+    EXPECT_EQ(0x10, option(s_accepted, IPPROTO_IPV6, IPV6_TCLASS));
+
+    auto * bev = client->eject();
+    auto client_sock = bufferevent_getfd(bev);
+    EXPECT_NE(0, option(client_sock, IPPROTO_TCP, TCP_NODELAY));
+    EXPECT_EQ(45, option(client_sock, IPPROTO_TCP, TCP_KEEPIDLE));
+    EXPECT_EQ(2000, option(client_sock, IPPROTO_TCP, TCP_USER_TIMEOUT));
+    bufferevent_free(bev);
+}
+
+TEST(SocketOptions, failure) {
+    int fds[2];
+    ASSERT_EQ(0, ::pipe(fds));
+    EXPECT_THROW(covent::apply(fds[0], {.nodelay = true}, false), covent::covent_runtime_error);
+    EXPECT_NO_THROW(covent::apply(fds[0], {}, false)); // Nothing asked for, nothing done.
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
@@ -0,0 +1,101 @@
+//
+// Created by dwd on 10/17/26.
+//
+
+#include <covent/timer-wheel.h>
+#include <gtest/gtest.h>
+
+using namespace std::chrono_literals;
+
+namespace {
+    using Wheel = covent::detail::TimerWheel;
+
+    std::size_t fire(Wheel & wheel, Wheel::clock::time_point now) {
+        std::vector<std::function<void()>> out;
+        wheel.expire(out, now);
+        for (auto const & fn : out) fn();
+        return out.size();
+    }
+}
+
+GTEST_TEST(TimerWheel, immediate) {
+    auto origin = Wheel::clock::now();
+    Wheel wheel(origin);
+    bool trap = false;
+    wheel.add([&trap]() { trap = true; }, 0ms, origin);
+    EXPECT_EQ(wheel.next_expiry(origin), Wheel::clock::duration::zero());
+    EXPECT_EQ(fire(wheel, origin), 1);
+    EXPECT_TRUE(trap);
+    EXPECT_TRUE(wheel.empty());
+}
+
+GTEST_TEST(TimerWheel, never_early) {
+    auto origin = Wheel::clock::now();
+    Wheel wheel(origin);
+    bool trap = false;
+    wheel.add([&trap]() { trap = true; }, 1500us, origin);
+    EXPECT_EQ(fire(wheel, origin + 1ms), 0);
+    EXPECT_FALSE(trap);
+    EXPECT_EQ(fire(wheel, origin + 2ms), 1);
+    EXPECT_TRUE(trap);
+}
+
+GTEST_TEST(TimerWheel, order) {
+    auto origin = Wheel::clock::now();
+    Wheel wheel(origin);
+    std::vector<int> fired;
+    // Spread across several levels, inserted out of order.
+    for (int i : {70000, 5, 300000, 64, 4096, 1, 63, 262144, 4095}) {
+        wheel.add([&fired, i]() { fired.push_back(i); }, std::chrono::milliseconds(i), origin);
+    }
+    EXPECT_EQ(wheel.size(), 9);
+    // Turn the wheel a tick at a time for a while, then jump.
+    for (auto t = 0ms; t < 5000ms; t += 1ms) fire(wheel, origin + t);
+    EXPECT_EQ(fired, (std::vector<int>{1, 5, 63, 64, 4095, 4096}));
+    fire(wheel, origin + 1h);
+    EXPECT_EQ(fired, (std::vector<int>{1, 5, 63, 64, 4095, 4096, 70000, 262144, 300000}));
+    EXPECT_TRUE(wheel.empty());
+}
+
+GTEST_TEST(TimerWheel, next_expiry) {
+    auto origin = Wheel::clock::now();
+    Wheel wheel(origin);
+    EXPECT_FALSE(wheel.next_expiry(origin).has_value());
+    wheel.add([]() {}, 100s, origin);
+    auto next = wheel.next_expiry(origin);
+    ASSERT_TRUE(next.has_value());
+    // May be early (a cascade point), but never late.
+    EXPECT_LE(*next, 100s);
+    auto now = origin;
+    int turns = 0;
+    while (!wheel.empty()) {
+        now += *wheel.next_expiry(now);
+        fire(wheel, now);
+        ++turns;
+    }
+    EXPECT_GE(now, origin + 100s);
+    EXPECT_LT(turns, 10);
+}
+
+GTEST_TEST(TimerWheel, cancel) {
+    auto origin = Wheel::clock::now();
+    Wheel wheel(origin);
+    bool trap1 = false;
+    bool trap2 = false;
+    auto id1 = wheel.add([&trap1]() { trap1 = true; }, 10ms, origin);
+    auto id2 = wheel.add([&trap2]() { trap2 = true; }, 10ms, origin);
+    EXPECT_TRUE(wheel.pending(id1));
+    EXPECT_TRUE(wheel.cancel(id1));
+    EXPECT_FALSE(wheel.pending(id1));
+    EXPECT_FALSE(wheel.cancel(id1));
+    EXPECT_EQ(fire(wheel, origin + 10ms), 1);
+    EXPECT_FALSE(trap1);
+    EXPECT_TRUE(trap2);
+    EXPECT_FALSE(wheel.cancel(id2));
+    // Slots are reused, but old ids stay dead.
+    auto id3 = wheel.add([]() {}, 10ms, origin);
+    EXPECT_NE(id3, id1);
+    EXPECT_NE(id3, id2);
+    EXPECT_FALSE(wheel.pending(id1));
+    EXPECT_TRUE(wheel.pending(id3));
+}
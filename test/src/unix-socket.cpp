@@ -0,0 +1,157 @@
+//
+// Created by dwd on 10/17/26.
+//
+
+#include "gtest/gtest.h"
+#include <covent/covent.h>
+#include <covent/datagram.h>
+#include <covent/http.h>
+#include <covent/listener.h>
+#include <covent/loop.h>
+#include <covent/loop-group.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstdio>
+#include <cstddef>
+#include <string>
+#include <thread>
+
+namespace {
+    class Echo : public covent::Session {
+    public:
+        using covent::Session::Session;
+
+        covent::task<std::size_t> process(std::string_view data) override {
+            write(data);
+            co_return data.size();
+        }
+    };
+
+    class Collector : public covent::Session {
+    public:
+        using covent::Session::Session;
+        std::string received;
+
+        covent::task<std::size_t> process(std::string_view data) override {
+            received += data;
+            co_return data.size();
+        }
+    };
+
+    std::string socket_path(std::string const & name) {
+        return "/tmp/covent-test-" + std::to_string(::getpid()) + "-" + name + ".sock";
+    }
+
+    bool exists(std::string const & path) {
+        struct stat st = {};
+        return ::lstat(path.c_str(), &st) == 0;
+    }
+
+    void echo_over(std::string const & address) {
+        covent::Loop loop;
+        covent::Listener<Echo> listener(loop, address, 0);
+        EXPECT_EQ(AF_UNIX, listener.sockaddr()->sa_family);
+        EXPECT_EQ(address, covent::address_tostring(listener.sockaddr()));
+        loop.listen(listener);
+        auto addr = covent::unix_sockaddr(address);
+        auto client = std::make_shared<Collector>(loop);
+        loop.run_task(client->connect(&addr));
+        client->write("Hello over a Unix socket");
+        for (int i = 0; i != 500 && client->received.size() < 24; ++i) loop.run_once(false);
+        EXPECT_EQ("Hello over a Unix socket", client->received);
+    }
+}
+
+TEST(UnixSocket, sockaddr) {
+    auto path = covent::unix_sockaddr("/run/covent.sock");
+    EXPECT_EQ(AF_UNIX, path.ss_family);
+    EXPECT_EQ("/run/covent.sock", covent::address_tostring(&path));
+    EXPECT_EQ(0, covent::address_toport(&path));
+    EXPECT_EQ(offsetof(struct sockaddr_un, sun_path) + 17, covent::sockaddr_len(&path));
+    auto abstract = covent::unix_sockaddr("@covent");
+    EXPECT_EQ('\0', covent::sockaddr_cast<AF_UNIX>(&abstract)->sun_path[0]);
+    EXPECT_EQ("@covent", covent::address_tostring(&abstract));
+    EXPECT_EQ(offsetof(struct sockaddr_un, sun_path) + 7, covent::sockaddr_len(&abstract));
+    EXPECT_THROW(covent::unix_sockaddr(""), std::length_error);
+    EXPECT_THROW(covent::unix_sockaddr("/" + std::string(200, 'x')), std::length_error);
+}
+
+TEST(UnixSocket, path) {
+    auto path = socket_path("echo");
+    echo_over(path);
+    EXPECT_FALSE(exists(path)); // Cleaned up after.
+}
+
+TEST(UnixSocket, abstract) {
+    echo_over("@covent-test-" + std::to_string(::getpid()));
+}
+
+TEST(UnixSocket, stale_path) {
+    auto path = socket_path("stale");
+    {
+        // Left behind by a previous run that didn't exit cleanly.
+        auto addr = covent::unix_sockaddr(path);
+        auto sock = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        ASSERT_EQ(0, ::bind(sock, covent::sockaddr_cast<AF_UNSPEC>(&addr), covent::sockaddr_len(&addr)));
+        ::close(sock);
+    }
+    ASSERT_TRUE(exists(path));
+    echo_over(path);
+}
+
+// Whatever's at the path by the time a datagram endpoint goes is only removed if it's still a socket.
+TEST(UnixSocket, datagram_replaced) {
+    auto path = socket_path("replaced");
+    {
+        covent::Loop loop;
+        covent::DatagramEndpoint endpoint(loop, path, 0);
+        ASSERT_TRUE(exists(path));
+        ::unlink(path.c_str());
+        std::FILE * f = std::fopen(path.c_str(), "w");
+        ASSERT_NE(nullptr, f);
+        std::fclose(f);
+    }
+    EXPECT_TRUE(exists(path));
+    ::unlink(path.c_str());
+}
+
+TEST(UnixSocket, no_group) {
+    covent::Loop loop;
+    covent::LoopGroup group(2, false);
+    covent::Listener<Echo> listener(loop, "@covent-group", 0);
+    EXPECT_THROW(listener.listen(group), covent::covent_logic_error);
+}
+
+TEST(UnixSocket, http_server) {
+    auto path = socket_path("http");
+    covent::Loop loop;
+    {
+        covent::http::Server srv(path, false);
+        srv.add(std::make_unique<covent::http::Endpoint>("/"));
+        srv.add(std::make_unique<covent::http::Endpoint>("/test", [](evhttp_request * req) -> covent::task<int> {
+            evhttp_send_reply(req, 201, "Created", nullptr);
+            co_return 201;
+        }));
+        EXPECT_TRUE(exists(path));
+        std::string response;
+        std::atomic<bool> done = false;
+        std::jthread client([&path, &response, &done]() {
+            auto addr = covent::unix_sockaddr(path);
+            auto sock = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            if (::connect(sock, covent::sockaddr_cast<AF_UNSPEC>(&addr), covent::sockaddr_len(&addr)) == 0) {
+                std::string request = "GET /test HTTP/1.0\r\nHost: localhost\r\n\r\n";
+                ::send(sock, request.data(), request.size(), MSG_NOSIGNAL);
+                char buf[1024];
+                for (ssize_t n; (n = ::recv(sock, buf, sizeof(buf), 0)) > 0;) response.append(buf, static_cast<std::size_t>(n));
+            }
+            ::close(sock);
+            done = true;
+        });
+        loop.run_until([&done]() { return done.load(); });
+        client.join();
+        EXPECT_TRUE(response.starts_with("HTTP/1.0 201")) << response;
+    }
+    EXPECT_FALSE(exists(path));
+}